@@ -0,0 +1,131 @@
+#include "BlepOscillator.hpp"
+#include "Wavetable.hpp"
+#include "config.hpp"
+
+BlepOscillator::BlepOscillator() {} // Default constructor
+
+BlepOscillator::BlepOscillator(WaveType wave_type, float freq)
+    : wave_type_(wave_type) {
+    set_freq(freq);
+}
+
+void BlepOscillator::set_freq(float new_freq) {
+    set_phase_increment(
+        static_cast<uint32_t>(new_freq / 44100.f * 4294967296.0f));
+}
+
+void BlepOscillator::set_phase_increment(uint32_t increment) {
+    phase_increment = increment;
+    step = increment >> rate_shift;
+    uint32_t step16 = step >> 16;
+    inv_step = step16 ? (1u << 31) / step16 : 0;
+}
+
+void BlepOscillator::set_oversampling(bool enable) {
+    rate_shift = enable ? 1 : 0;
+    set_phase_increment(phase_increment);
+}
+
+void BlepOscillator::set_pulse_width(uint16_t width_q16) {
+    // Keep both edges apart so their residuals never overlap badly
+    if (width_q16 < 1024)
+        width_q16 = 1024;
+    if (width_q16 > 65535 - 1024)
+        width_q16 = 65535 - 1024;
+    pulse_width = static_cast<uint32_t>(width_q16) << 16;
+}
+
+int32_t BlepOscillator::poly_blep(uint32_t t) const {
+    if (t < step) {
+        // Just after the edge, x = t / step
+        int32_t x = ((t >> 16) * inv_step) >> 16;
+        int32_t r = 32768 - x;
+        return -((r * r) >> 15);
+    }
+    if (-t < step) {
+        // Just before the edge, x = (1 - t) / step
+        int32_t x = ((-t >> 16) * inv_step) >> 16;
+        int32_t r = 32768 - x;
+        return (r * r) >> 15;
+    }
+    return 0;
+}
+
+int32_t BlepOscillator::poly_blamp(uint32_t t) const {
+    // Integral of the BLEP residual, (1 - x)^3 on both sides of the corner.
+    // The 1/6 is folded into the caller's scale.
+    uint32_t d = t < step ? t : -t;
+    if (d >= step)
+        return 0;
+    int32_t x = ((d >> 16) * inv_step) >> 16;
+    int32_t r = 32768 - x;
+    return (((r * r) >> 15) * r) >> 15;
+}
+
+void BlepOscillator::render(int32_t *mix, size_t size, q8_24_t gain,
+                            q8_24_t gain_inc) {
+    switch (wave_type_) {
+    case Square:
+        render_kernel<Square>(mix, size, gain, gain_inc);
+        break;
+    case Triangle:
+        render_kernel<Triangle>(mix, size, gain, gain_inc);
+        break;
+    case Sawtooth:
+        render_kernel<Sawtooth>(mix, size, gain, gain_inc);
+        break;
+    case Sinc:
+        render_kernel<Sinc>(mix, size, gain, gain_inc);
+        break;
+    default:
+        render_kernel<Sine>(mix, size, gain, gain_inc);
+        break;
+    }
+}
+
+template <WaveType wave>
+void BlepOscillator::render_kernel(int32_t *mix, size_t size, q8_24_t gain,
+                                   q8_24_t gain_inc) {
+    uint32_t t = phase;
+    // Triangle corners change the slope by 8 * step per sample (in units of
+    // full scale), times the 1/6 of the BLAMP polynomial
+    const int32_t blamp_scale = static_cast<int32_t>(((step >> 17) * 4) / 3);
+
+    for (size_t i = 0; i < size; i++) {
+        int32_t value;
+
+        if constexpr (wave == Sawtooth) {
+            // Rising ramp from -1 to 1, falling edge at t = 0
+            value = static_cast<int32_t>(t >> 16) - 32768;
+            value -= poly_blep(t);
+        } else if constexpr (wave == Square) {
+            // High for pulse_width, rising edge at 0, falling at pulse_width
+            value = t < pulse_width ? 32767 : -32768;
+            value += poly_blep(t);
+            value -= poly_blep(t - pulse_width);
+        } else if constexpr (wave == Triangle) {
+            // -1 at t = 0 up to 1 at t = 1/2, corners at both
+            int32_t p = static_cast<int32_t>(t >> 16);
+            value = p < 32768 ? 2 * p - 32768 : 98303 - 2 * p;
+            value += (poly_blamp(t) * blamp_scale) >> 15;
+            value -= (poly_blamp(t - (1u << 31)) * blamp_scale) >> 15;
+        } else if constexpr (wave == Sinc) {
+            value = sinc_table[t >> 23];
+        } else {
+            value = sine_wave_table[t >> 23];
+        }
+
+        if (value > INT16_MAX)
+            value = INT16_MAX;
+        if (value < INT16_MIN)
+            value = INT16_MIN;
+
+        int16_t sample = static_cast<int16_t>((value * (gain >> 10)) >> 14);
+        // divide by 8
+        mix[i] += sample >> 3;
+        gain += gain_inc;
+
+        t += step;
+    }
+    phase = t;
+}
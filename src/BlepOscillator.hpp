@@ -0,0 +1,50 @@
+#ifndef BLEP_OSCILLATOR_HPP
+#define BLEP_OSCILLATOR_HPP
+
+#include "Wavetable.hpp"
+#include "config.hpp"
+#include "fixed_point.h"
+#include <cstddef>
+#include <cstdint>
+
+// Oscillator that computes saw, pulse and triangle straight from the phase
+// accumulator. Discontinuities are smoothed with a 2-point PolyBLEP (steps)
+// or PolyBLAMP (corners), so no table is read per sample and the pulse
+// width can be modulated freely. Sine and sinc fall back to their tables.
+class BlepOscillator {
+  public:
+    BlepOscillator();
+    BlepOscillator(WaveType wave_type, float freq);
+
+    // Same contract as Oscillator::render()
+    void render(int32_t *mix, size_t size, q8_24_t gain, q8_24_t gain_inc);
+    void set_freq(float new_freq);
+    // Same contract as Oscillator::set_phase_increment()
+    void set_phase_increment(uint32_t increment);
+    // Run at twice the output rate, for the oversampled voice path
+    void set_oversampling(bool enable);
+    void set_wavetable(WaveType wave_type) { wave_type_ = wave_type; }
+    WaveType get_wave_type() const { return wave_type_; }
+
+    // Fraction of the period spent high for Square, in Q16
+    void set_pulse_width(uint16_t width_q16);
+
+  private:
+    template <WaveType wave>
+    void render_kernel(int32_t *mix, size_t size, q8_24_t gain,
+                       q8_24_t gain_inc);
+
+    // Residuals for a unit step or corner at phase 0, in Q15
+    int32_t poly_blep(uint32_t t) const;
+    int32_t poly_blamp(uint32_t t) const;
+
+    WaveType wave_type_ = Sawtooth;
+    uint32_t phase = 0;   // one period is 2^32
+    uint32_t step = 0;    // phase increment per sample
+    uint32_t inv_step = 0; // 2^31 / (step >> 16), turns t / step into a mul
+    uint32_t pulse_width = 1u << 31;
+    uint32_t phase_increment = 0; // at 44.1 kHz
+    int rate_shift = 0;           // 1 when oversampling
+};
+
+#endif // !BLEP_OSCILLATOR_HPP
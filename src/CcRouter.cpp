@@ -0,0 +1,126 @@
+#include "CcRouter.hpp"
+#include "Filter.hpp"
+#include "Synth.hpp"
+#include <cmath>
+
+const char *cc_target_to_string(CcRouter::Target target) {
+    switch (target) {
+    case CcRouter::CC_NONE:
+        return "None";
+    case CcRouter::CC_CUTOFF:
+        return "Cutoff";
+    case CcRouter::CC_RESONANCE:
+        return "Resonance";
+    case CcRouter::CC_ATTACK:
+        return "Attack";
+    case CcRouter::CC_DECAY:
+        return "Decay";
+    case CcRouter::CC_SUSTAIN:
+        return "Sustain";
+    case CcRouter::CC_RELEASE:
+        return "Release";
+    case CcRouter::CC_VOLUME:
+        return "Volume";
+    case CcRouter::CC_WAVE_TYPE:
+        return "Wave type";
+    default:
+        return "Unknown";
+    }
+}
+
+CcRouter::CcRouter(Synth &synth) : synth(synth) {
+    // General MIDI sound controllers where there is one, CC 2 is what the
+    // old cutoff stub listened to
+    routes[2] = CC_CUTOFF;
+    routes[7] = CC_VOLUME;
+    routes[70] = CC_WAVE_TYPE;
+    routes[71] = CC_RESONANCE;
+    routes[72] = CC_RELEASE;
+    routes[73] = CC_ATTACK;
+    routes[74] = CC_CUTOFF;
+    routes[75] = CC_DECAY;
+    routes[79] = CC_SUSTAIN;
+}
+
+void CcRouter::set_route(uint8_t controller, Target target) {
+    if (controller < routes.size())
+        routes[controller] = target;
+}
+
+CcRouter::Target CcRouter::get_route(uint8_t controller) const {
+    return controller < routes.size() ? static_cast<Target>(routes[controller])
+                                      : CC_NONE;
+}
+
+void CcRouter::control_change(uint8_t controller, uint8_t value) {
+    Target target = get_route(controller);
+    if (target == CC_NONE)
+        return;
+
+    targets[target] = ((int32_t)(value & 0x7F) << 16) / 127;
+    // The first message says where the knob is, there is nothing to glide
+    // from yet
+    if (!(seen & (1u << target))) {
+        seen |= 1u << target;
+        positions[target] = targets[target];
+    }
+    moving |= 1u << target;
+}
+
+void CcRouter::update() {
+    if (moving == 0)
+        return;
+
+    SynthParams &params = synth.edit_params();
+    for (uint32_t pending = moving; pending != 0; pending &= pending - 1) {
+        Target target = static_cast<Target>(__builtin_ctz(pending));
+        int32_t distance = targets[target] - positions[target];
+        if (target == CC_WAVE_TYPE || (distance < SNAP && distance > -SNAP)) {
+            positions[target] = targets[target];
+            moving &= ~(1u << target);
+        } else {
+            positions[target] += distance >> SMOOTH_SHIFT;
+        }
+        apply(params, target, positions[target]);
+    }
+    // Every parameter moved this block reaches the renderer together
+    synth.publish_params();
+}
+
+// Envelope stage time from 1 ms to 4 s, in Q8.24 seconds
+static q8_24_t stage_time(float x) {
+    return q24_from_float(0.001f * powf(4000.f, x));
+}
+
+void CcRouter::apply(SynthParams &params, Target target, int32_t position) {
+    const float x = position / 65536.f;
+
+    switch (target) {
+    case CC_CUTOFF:
+        if (params.filter_type != FILTER_OFF)
+            params.cutoff[params.filter_type] = 20.f * powf(1000.f, x);
+        break;
+    case CC_RESONANCE:
+        params.resonance = SVF_MIN_Q * powf(SVF_MAX_Q / SVF_MIN_Q, x);
+        break;
+    case CC_ATTACK:
+    case CC_DECAY:
+    case CC_SUSTAIN:
+    case CC_RELEASE:
+        // The targets are in increment_ADSR() order, sustain is a level
+        params.adsr[target - CC_ATTACK] =
+            target == CC_SUSTAIN ? position << 8 : stage_time(x);
+        break;
+    case CC_VOLUME:
+        params.volume = position >> 8;
+        break;
+    case CC_WAVE_TYPE: {
+        // Equal slices of the CC range, the last one is Sinc
+        int wave = (position * (Sinc + 1)) >> 16;
+        params.wave_type = static_cast<WaveType>(wave > Sinc ? Sinc : wave);
+        break;
+    }
+    default:
+        break;
+    }
+}
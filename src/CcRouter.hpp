@@ -0,0 +1,59 @@
+#ifndef CC_ROUTER_HPP
+#define CC_ROUTER_HPP
+
+#include <array>
+#include <cstdint>
+
+class Synth; // Forward declaration
+struct SynthParams;
+
+// Routes MIDI control changes to synth parameters. A message only looks up
+// its controller and stores the new target. update() runs once per block
+// and moves every parameter part of the way to its target, so a stream of
+// CCs costs at most one parameter (and coefficient) update per block. Both
+// run on the UI side and write through Synth::edit_params().
+class CcRouter {
+  public:
+    enum Target {
+        CC_NONE,
+        CC_CUTOFF,    // global filter, 20 Hz to 20 kHz
+        CC_RESONANCE, // SVF Q
+        CC_ATTACK,    // 1 ms to 4 s, every voice
+        CC_DECAY,
+        CC_SUSTAIN,
+        CC_RELEASE,
+        CC_VOLUME,
+        CC_WAVE_TYPE, // jumps, no glide
+        NUM_CC_TARGETS
+    };
+
+    CcRouter(Synth &synth);
+
+    void control_change(uint8_t controller, uint8_t value);
+    // Glide the parameters one step, call once per rendered block
+    void update();
+
+    void set_route(uint8_t controller, Target target);
+    Target get_route(uint8_t controller) const;
+
+  private:
+    void apply(SynthParams &params, Target target, int32_t position);
+
+    Synth &synth;
+    std::array<uint8_t, 128> routes = {}; // Target of every controller
+
+    // Positions in Q16 of full scale (CC 127)
+    std::array<int32_t, NUM_CC_TARGETS> targets = {};
+    std::array<int32_t, NUM_CC_TARGETS> positions = {};
+    uint32_t moving = 0; // targets not reached yet, one bit each
+    uint32_t seen = 0;   // targets that had a message, the first one jumps
+
+    // Each block closes a quarter of the distance and the last 1/256 of
+    // full scale is a jump, a full sweep settles in about 20 blocks
+    static constexpr int SMOOTH_SHIFT = 2;
+    static constexpr int32_t SNAP = 1 << 8;
+};
+
+const char *cc_target_to_string(CcRouter::Target target);
+
+#endif // !CC_ROUTER_HPP
@@ -7,88 +7,103 @@
 #define FRAC_BITS 24
 
 ADSREnvelope::ADSREnvelope()
-    : a(), d(16777216), s(6710886), r(16777216), in_signal(nullptr),
-      trigger(0.f), state(ENV_IDLE) {} // Default constructor
+    : a(), d(16777216), s(6710886), r(16777216), trigger(0.f),
+      state(ENV_IDLE) {
+    recalculate_increments();
+} // Default constructor
 
 ADSREnvelope::ADSREnvelope(float a_in, float d_in, float s_in, float r_in,
-                           std::array<int16_t, SAMPLES_PER_BUFFER> &in_signal,
                            float trigger)
-    : in_signal(&in_signal), trigger(trigger) {
-    a = q24_from_float(a_in);
-    d = q24_from_float(d_in);
-    s = q24_from_float(s_in);
-    r = q24_from_float(r_in);
+    : trigger(trigger) {
+    set_ADSR(a_in, d_in, s_in, r_in);
 }
 
-void ADSREnvelope::out() {
-    uint32_t scale = 0;
+// Length of a stage in samples, negative times count as zero
+static uint32_t seconds_to_samples(q8_24_t seconds) {
+    if (seconds <= 0)
+        return 0;
+    return (uint32_t)(((int64_t)seconds * 44100) >> FRAC_BITS);
+}
 
-    // Note released
-    if (trigger < 4.5f && state != ENV_RELEASE && state != ENV_IDLE) {
-        release_start_level = current_scale;
-        t = 0;
-        state = ENV_RELEASE;
-    }
+void ADSREnvelope::recalculate_increments() {
+    // The only divisions of the envelope, run on parameter changes
+    attack_samples = seconds_to_samples(a);
+    decay_samples = seconds_to_samples(d);
+    release_samples = seconds_to_samples(r);
+
+    attack_inc = attack_samples ? FIXED_ONE / (int32_t)attack_samples : 0;
+    decay_inc = decay_samples ? -(FIXED_ONE - s) / (int32_t)decay_samples : 0;
+    release_recip =
+        release_samples > 1 ? (uint32_t)((1ull << 32) / release_samples)
+                            : UINT32_MAX;
+
+    // A held note follows the sustain level straight away
+    if (state == ENV_SUSTAIN)
+        level = s;
+}
 
+void ADSREnvelope::enter_state(EnvelopeState new_state) {
+    state = new_state;
     switch (state) {
     case ENV_ATTACK:
-        scale = q24_div(t, a);
-        if (t >= a) {
-            state = ENV_DECAY;
-            t = 0;
-            scale = Q24_ONE; // Force exactly 1.0 at transition
-        }
+        level = 0;
+        inc = attack_inc;
+        remaining = attack_samples;
         break;
 
-    case ENV_DECAY: {
-        q8_24_t one_minus_s = q24_sub(Q24_ONE, s);
-        scale = Q24_ONE - q24_mul(one_minus_s, q24_div(t, d));
-        if (t >= d) {
-            state = ENV_SUSTAIN;
-            t = 0;
-            scale = s; // Force exactly sustain level at transition
-        }
+    case ENV_DECAY:
+        level = FIXED_ONE; // Force exactly 1.0 at transition
+        inc = decay_inc;
+        remaining = decay_samples;
         break;
-    }
-    case ENV_SUSTAIN:
 
-        // printf("Env Sustain\n\r");
-        scale = s;
+    case ENV_SUSTAIN:
+        level = s; // Force exactly sustain level at transition
+        inc = 0;
+        remaining = UINT32_MAX;
         break;
 
     case ENV_RELEASE:
-
-        // printf("Env Release\n\r");
-        if (trigger > 4.5f) {
-            state = ENV_ATTACK;
-            t = 0;
-        }
-        scale = q24_mul(release_start_level, (Q24_ONE - q24_div(t, r)));
-        // scale = release_start_level * (1.0f - (t / r));
-        if (t >= r) {
-            scale = 0.0f;
-            state = ENV_IDLE;
-        }
+        // Fall from wherever the note was released, level / release_samples
+        // per sample, as a multiply by the precomputed reciprocal
+        inc = -(q8_24_t)(((uint64_t)level * release_recip) >> 32);
+        remaining = release_samples;
         break;
 
     case ENV_IDLE:
-        if (trigger > 4.5f) {
-            state = ENV_ATTACK;
-            t = 0;
-        }
-        scale = 0.0f;
+        level = 0;
+        inc = 0;
+        remaining = UINT32_MAX;
         break;
     }
+}
 
-    for (uint i = 0; i < SAMPLES_PER_BUFFER; i++) {
+EnvelopeSegment ADSREnvelope::next_segment(size_t max_size) {
+    // Gate changes are picked up at the start of a segment
+    bool gate = trigger > 4.5f;
+    if (!gate && state != ENV_RELEASE && state != ENV_IDLE) {
+        enter_state(ENV_RELEASE); // Note released
+    } else if (gate && (state == ENV_RELEASE || state == ENV_IDLE)) {
+        enter_state(ENV_ATTACK);
+    }
 
-        current_scale = scale;
-        int16_t scale_q2_14 = (int16_t)(scale >> 10);
-        output[i] = static_cast<int16_t>(
-            // (static_cast<int64_t>((*in_signal)[i]) * scale) >> 24);
-            (static_cast<int32_t>((*in_signal)[i]) * scale_q2_14) >> 14);
-        t += SAMPLE_DELTA;
+    // Zero length stages are skipped without producing samples
+    while (remaining == 0) {
+        enter_state(static_cast<EnvelopeState>(state + 1));
     }
+
+    size_t count = max_size < remaining ? max_size : remaining;
+    EnvelopeSegment segment = {level, inc, count};
+
+    level += inc * (q8_24_t)count;
+    if (remaining != UINT32_MAX) {
+        remaining -= count;
+        if (remaining == 0) {
+            // Stage ends on this sample, start the next one exactly here
+            enter_state(static_cast<EnvelopeState>(state + 1));
+        }
+    }
+    return segment;
 }
 
 void ADSREnvelope::set_trigger(float trig) { trigger = trig; }
@@ -98,6 +113,7 @@ void ADSREnvelope::set_ADSR(float a_in, float d_in, float s_in, float r_in) {
     d = q24_from_float(d_in);
     s = q24_from_float(s_in);
     r = q24_from_float(r_in);
+    recalculate_increments();
 }
 
 void ADSREnvelope::increment_ADSR(uint8_t which, int32_t delta_q24) {
@@ -122,6 +138,28 @@ void ADSREnvelope::increment_ADSR(uint8_t which, int32_t delta_q24) {
     default:
         break;
     }
+    recalculate_increments();
+}
+
+void ADSREnvelope::set_ADSR_param(uint8_t which, q8_24_t value) {
+    value = value < 0 ? 0 : value;
+    switch (which) {
+    case 0: // Attack
+        a = value;
+        break;
+    case 1: // Decay
+        d = value;
+        break;
+    case 2: // Sustain
+        s = value > FIXED_ONE ? FIXED_ONE : value;
+        break;
+    case 3: // Release
+        r = value;
+        break;
+    default:
+        break;
+    }
+    recalculate_increments();
 }
 
 std::array<int32_t, 4> ADSREnvelope::get_ADSR() { return {a, d, s, r}; }
@@ -135,8 +173,4 @@ void ADSREnvelope::get_ADSR_strings(char out[4][8]) {
     }
 }
 
-void ADSREnvelope::set_idle() { state = ENV_IDLE; }
-
-std::array<int16_t, SAMPLES_PER_BUFFER> &ADSREnvelope::get_output() {
-    return output;
-}
+void ADSREnvelope::set_idle() { enter_state(ENV_IDLE); }
@@ -4,27 +4,42 @@
 #include "config.hpp"
 #include "fixed_point.h"
 #include <array>
+#include <cstddef>
 #include <cstdint>
 #include <pico/types.h>
 
+// Run of samples over which the envelope gain is a straight line
+struct EnvelopeSegment {
+    q8_24_t level; // gain at the first sample
+    q8_24_t inc;   // added to the gain after every sample
+    size_t count;  // number of samples in the run
+};
+
 // ADSR Envelope Class
+//
+// The envelope is a piecewise linear ramp. Per-sample increments are
+// precomputed whenever a parameter changes, so rendering only adds, and each
+// stage ends exactly on the sample where it runs out.
 class ADSREnvelope {
   public:
     ADSREnvelope(); // Default Constructor
-    ADSREnvelope(float a, float d, float s, float r,
-                 std::array<int16_t, SAMPLES_PER_BUFFER> &in_signal,
-                 float trigger);
+    ADSREnvelope(float a, float d, float s, float r, float trigger);
 
-    void out();
+    // Take the next linear run of at most max_size samples. A block is
+    // covered by calling this until the counts add up to its size.
+    EnvelopeSegment next_segment(size_t max_size);
     void set_trigger(float trig);
     void set_idle();
+    // False once the release has run out and no new note is pending
+    bool is_active() const { return state != ENV_IDLE || trigger > 4.5f; }
+    q8_24_t get_level() const { return level; }
 
     void set_ADSR(float a_in, float d_in, float s_in,
                                 float r_in); 
 
-    std::array<int16_t, SAMPLES_PER_BUFFER> &get_output();
-
     void increment_ADSR(uint8_t which, int32_t delta_q24);
+    // Set one stage, numbered as in increment_ADSR(), in Q8.24
+    void set_ADSR_param(uint8_t which, q8_24_t value);
 
     std::array<int32_t, 4> get_ADSR();
 
@@ -39,23 +54,30 @@ class ADSREnvelope {
         ENV_IDLE
     };
 
-    std::array<int16_t, SAMPLES_PER_BUFFER> *in_signal;
-    std::array<int16_t, SAMPLES_PER_BUFFER> output;
+    void recalculate_increments();
+    void enter_state(EnvelopeState new_state);
 
     // Use fixed-point arithmetic for envelope (8.24 format)
     q8_24_t a, d, s, r; // Attack, Decay, Sustain, Release times in seconds
-    q8_24_t current_scale = 0;
-    q8_24_t release_start_level = 0.0f;
-    q8_24_t t = 0; // Time tracking for envelope phases
+
+    // Precomputed from a, d, s, r by recalculate_increments()
+    uint32_t attack_samples = 0;
+    uint32_t decay_samples = 0;
+    uint32_t release_samples = 0;
+    q8_24_t attack_inc = 0;
+    q8_24_t decay_inc = 0;
+    uint32_t release_recip = 0; // 2^32 / release_samples
+
+    // Current ramp
+    q8_24_t level = 0;
+    q8_24_t inc = 0;
+    uint32_t remaining = UINT32_MAX; // samples left in the current stage
 
     float trigger;
     EnvelopeState state = ENV_IDLE;
-    float sample_delta = 1.0f / 44100.0f; // Buffer time increment
 
     // Precompute constants
     static constexpr q8_24_t FIXED_ONE = Q24_ONE; // 1.0 in 8.24 format
-    static constexpr uint32_t SAMPLE_DELTA = static_cast<uint32_t>(
-        1.0f / 44100.0f * FIXED_ONE); // Buffer time increment
 };
 
 #endif // !ENVELOPE_HPP
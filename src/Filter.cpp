@@ -3,32 +3,63 @@
 #include "config.hpp"
 #include "fixed_point.h"
 #include "tusb.h"
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
 
-FilterFIR::FilterFIR(float freq_c) { set_cutoff_freq(freq_c); }
+FilterFIR::FilterFIR(float freq_c) {
+    set_cutoff_freq(freq_c);
+    update_coefficients();
+}
 
 void FilterFIR::set_cutoff_freq(float freq_c) {
-
     cutoff_freq = q16_from_float(freq_c);
-    // fc_norm = q16_to_q24(q16_div(cutoff_freq, fs) << 1);
-    fc_norm = q24_from_float(freq_c / (44100.f / 2));
-    printf("%f\n", freq_c);
+    int index = (int)(freq_c / FIR_CUTOFF_STEP + 0.5f);
+    pending_index = index < 1 ? 1 : index;
+}
+
+void FilterFIR::update_coefficients() {
+    if (latest != nullptr && latest->cutoff_index == pending_index)
+        return;
+
+    // Reuse a cached set, or refill the least recently used one. out()
+    // reads its own copy, so any slot will do.
+    FirCoefficients *slot = nullptr;
+    for (auto &candidate : bank) {
+        if (candidate.cutoff_index == pending_index) {
+            slot = &candidate;
+            break;
+        }
+        if (slot == nullptr || candidate.last_used < slot->last_used)
+            slot = &candidate;
+    }
+    if (slot->cutoff_index != pending_index)
+        compute_coefficients(*slot, pending_index);
 
-    // Calculate filter coefficients
-    recalculate_coefficients();
+    slot->last_used = ++use_count;
+    latest = slot;
+    active.edit() = *slot;
+    active.publish();
 }
 
-void FilterFIR::recalculate_coefficients() {
-    // Use pre-calculated hanning window
-    // If FILTER_ORDER is the same as hanning_window_table_fp.size(),
-    // we can use the values directly
+void FilterFIR::compute_coefficients(FirCoefficients &slot, int cutoff_index) {
+    float freq_c = (float)(cutoff_index * FIR_CUTOFF_STEP);
+    q8_24_t fc_norm = q24_from_float(freq_c / (44100.f / 2));
+
+    // The transition band is set by the tap count, not the cutoff, so high
+    // cutoffs get away with a shorter kernel
+    const int num_taps =
+        freq_c >= FIR_SHORT_CUTOFF ? FIR_SHORT_TAPS : FILTER_ORDER;
+    std::array<q8_24_t, FILTER_ORDER> &h = slot.h;
 
     // Normalize coefficients to ensure unity gain at DC
     q8_24_t sum = q24_from_int(0);
-    q8_24_t M = q24_from_int(FILTER_ORDER - 1) >> 1;
-    for (int i = 0; i < FILTER_ORDER; i++) {
+    q8_24_t M = q24_from_int(num_taps - 1) >> 1;
+    // Shorter kernels take every window_step-th point of the window
+    const int window_step = (FILTER_ORDER - 1) / (num_taps - 1);
+    for (int i = 0; i < num_taps; i++) {
         // Calculate sinc value using pre-calculated table
         q8_24_t n_minus_M = q24_sub(q24_from_int(i), M);
         // q8_24_t x = q24_mul(q24_mul(q24_from_int(2), fc_norm), n_minus_M);
@@ -63,66 +94,80 @@ void FilterFIR::recalculate_coefficients() {
                                    q24_mul(weight, sinc_val_high));
 
         // Apply window function from pre-calculated table
-        h[i] = q24_mul(sinc_val, hanning_window_table_fp[i]);
-        h_q2_14[i] = (int16_t)(h[i] >> 10); // save as 16 bit aswell
+        h[i] = q24_mul(sinc_val, hanning_window_table_fp[i * window_step]);
         sum = q24_add(sum, h[i]);
     }
 
-    // Normalize coefficients
-    if (sum != 0) {
-        q8_24_t norm_factor = q24_div(q24_from_int(1), sum);
-        for (int i = 0; i < FILTER_ORDER; i++) {
-            h[i] = q24_mul(h[i], norm_factor);
-        }
+    // Normalize coefficients, then take the 16 bit copy the kernel uses
+    q8_24_t norm_factor = sum != 0 ? q24_div(q24_from_int(1), sum) : Q24_ONE;
+    for (int i = 0; i < num_taps; i++) {
+        h[i] = q24_mul(h[i], norm_factor);
+        slot.h_q2_14[i] = (int16_t)(h[i] >> 10);
     }
+
+    slot.num_taps = num_taps;
+    slot.cutoff_index = cutoff_index;
 }
 
 void FilterFIR::reset() {
-    for (int i = 0; i < FILTER_ORDER; i++) {
-        buffer[i] = 0;
-    }
-    buffer_index = 0;
+    delay.fill(0);
+    pos = 0;
+}
+
+const int16_t *FilterFIR::push(int16_t sample) {
+    delay[pos] = sample;
+    delay[pos + FILTER_ORDER] = sample;
+    const int16_t *window = &delay[pos + 1];
+    if (++pos == FILTER_ORDER)
+        pos = 0;
+    return window;
 }
 
 void FilterFIR::out(int16_t *samples, size_t size) {
+    // One coefficient set for the whole block
+    const FirCoefficients *set = &active.read();
+    const int num_taps = set->num_taps;
+
+    // A short kernel uses the middle of the window, so the delay through
+    // the filter stays the same when the tap count changes
+    const int first = (FILTER_ORDER - num_taps) / 2;
+    const int last = num_taps - 1;
+    const int half = num_taps / 2;
+    const int16_t *coeffs = set->h_q2_14.data();
+
     for (size_t i = 0; i < size; i++) {
-        buffer[buffer_index] = samples[i];
-        int32_t sum = 0;
-        for (size_t j = 0; j < FILTER_ORDER; j++) {
-            int sampleIndex = (buffer_index - j + FILTER_ORDER) % FILTER_ORDER;
-            sum += (int32_t)(buffer[sampleIndex] * h_q2_14[j]);
+        const int16_t *x = push(samples[i]) + first;
+
+        // The taps are symmetric, so pairs of samples share one multiply
+        int32_t sum = (int32_t)x[half] * coeffs[half];
+        for (int j = 0; j < half; j++) {
+            sum += (int32_t)(x[j] + x[last - j]) * coeffs[j];
         }
-        // Update buffer index for next sample
-        buffer_index = (buffer_index + 1) % FILTER_ORDER;
-        samples[i] =
-            (int16_t)(sum >> (3 + 14)); // scale due to number of filter
+        // Unity gain at DC, the coefficients are normalized, but a hot mix
+        // plus the ripple of the taps can still go over full scale
+        sum >>= 14;
+        if (sum > INT16_MAX)
+            sum = INT16_MAX;
+        if (sum < INT16_MIN)
+            sum = INT16_MIN;
+        samples[i] = (int16_t)sum;
     }
 }
 
-std::array<int16_t, SAMPLES_PER_BUFFER> &FilterFIR::get_output() { return output; }
-
 int16_t FilterFIR::process(int16_t sample) {
-    // Store new sample in circular buffer
-    buffer[buffer_index] = sample;
+    const FirCoefficients *set = &active.read();
+    const int num_taps = set->num_taps;
+    const q8_24_t *h = set->h.data();
+    const int16_t *x = push(sample) + (FILTER_ORDER - num_taps) / 2;
 
     // Perform convolution
     q8_24_t result = q24_from_int(0);
 
-    for (int i = 0; i < FILTER_ORDER; i++) {
-        // Calculate the correct buffer index
-        // This accesses newest sample first, then older samples
-        int sampleIndex = (buffer_index - i + FILTER_ORDER) % FILTER_ORDER;
-
-        // Get sample from circular buffer
-        const int16_t buf_sample = buffer[sampleIndex];
-
+    for (int i = 0; i < num_taps; i++) {
         // Convert to q8.24, multiply with coefficient, and accumulate
-        result = q24_add(result, q24_mul(q24_from_int(buf_sample), h[i]));
+        result = q24_add(result, q24_mul(q24_from_int(x[i]), h[i]));
     }
 
-    // Update buffer index for next sample
-    buffer_index = (buffer_index + 1) % FILTER_ORDER;
-
     // Convert result back to int16_t with proper rounding
     return (int16_t)q24_to_int(result);
 }
@@ -141,131 +186,413 @@ void FilterFIR::processChunkInPlace(int16_t *samples, size_t size) {
     }
 }
 
-int16_t
-lookup_table_interpolate(const std::array<int16_t, WAVE_TABLE_LEN> &table,
-                         int16_t x, size_t q) {
-    int16_t index = ((int32_t)x * (WAVE_TABLE_LEN)) >> q; // Scale based on q
-    // printf("index %d\n", index);
-
-    int16_t v1 = table[index];
-    int16_t v2 = table[index + 1];
-    // printf("v1 %f\n", q2_14_to_float(v1));
-    // printf("v2 %f\n", q2_14_to_float(v2));
+// c * w / 2^shift, rounded, for a 16-bit c >= 0, |w| < 2^27 and
+// 12 <= shift < 32, with two 32-bit multiplies instead of a 64-bit one.
+// round is (1 << (shift - 12)) >> 1.
+static inline int32_t mul_shift(int32_t c, int32_t w, int shift,
+                                int32_t round) {
+    int32_t hi = (c * (w >> 16)) << 4;
+    int32_t lo = c * (w & 0xFFFF);
+    return (hi + (lo >> 12) + round) >> (shift - 12);
+}
 
-    int16_t frac = (int16_t)((int32_t)x * (WAVE_TABLE_LEN)) -
-                   (index << q); // Compute fractional part
-    // printf("frac %f\n", q1_15_to_float(frac));
-    // Linear interpolation: (1 - frac) * v1 + frac * v2
-    return ((int32_t)v1 * ((1 << q) - frac) + (int32_t)v2 * frac) >> q;
+// mul_shift() without rounding, the dropped fraction goes into the next
+// call through err instead
+static inline int32_t mul_shift_carry(int32_t c, int32_t w, int shift,
+                                      int32_t &err) {
+    int32_t hi = (c * (w >> 16)) << 4;
+    int32_t lo = c * (w & 0xFFFF);
+    int32_t fine = hi + (lo >> 12) + err;
+    int32_t result = fine >> (shift - 12);
+    err = fine - (result << (shift - 12));
+    return result;
 }
 
-FilterCheb::FilterCheb(float fc, float epsilon, float fs) {
+// Samples in the cascade carry CHEB_FRAC_BITS below the int16 LSB. A
+// section output stays under four times full scale, so the sums the
+// coefficients multiply stay under 2^(20 + CHEB_FRAC_BITS), inside the
+// 2^30 cheb_product() takes.
+static constexpr int CHEB_FRAC_BITS = 9;
+// Largest coefficient shift, so the carries of cheb_product() fit in 32
+// bits
+static constexpr int CHEB_MAX_SHIFT = 44;
+
+// Split 0 < v < 1 into a 16-bit mantissa and a right shift, at most
+// CHEB_MAX_SHIFT
+static void cheb_mantissa(float v, int32_t &mantissa, int &shift) {
+    int exponent;
+    frexpf(v, &exponent);
+    shift = std::min(16 - exponent, CHEB_MAX_SHIFT);
+    mantissa = std::min((int32_t)lroundf(ldexpf(v, shift)), (int32_t)65535);
+}
 
-    // int16_t ep = float_to_q2_14(epsilon); // in ]0.3, 1]
+FilterCheb::FilterCheb(float fc, float epsilon) {
     set_cutoff_freq(fc, epsilon);
+    current = designs.read();
 }
 
 void FilterCheb::set_cutoff_freq(float fc, float epsilon) {
-
-    int16_t ep = float_to_q2_14(epsilon); // in ]0.3, 1]
-    float fs = 44100;
-    int16_t fc_norm = float_to_q1_15(fc / fs);
+    const float fs = 44100.f;
     cutoff_freq = q16_from_float(fc);
+    // Keep the bilinear transform away from DC and Nyquist
+    fc = fc < 20.f ? 20.f : (fc > 0.45f * fs ? 0.45f * fs : fc);
+    epsilon = epsilon < 0.1f ? 0.1f : epsilon;
 
-    // printf("fc_norm %f\n", q1_15_to_float(fc_norm));
-
-    // int16_t a = tan(M_PI * fc / fs); //here I can guarantee that a < 1
-    // because fc/fs < 0.25, so it can be q1.15 int16_t a = tan(M_PI * fc / fs);
-    // //here I can guarantee that a < 1 because fc/fs < 0.25, so it can be
-    // q1.15
-    //
-    int16_t a =
-        lookup_table_interpolate(tan_wave_table, fc_norm << 2, 15); // Q1.15
-
-    // printf("a = %f\n", q1_15_to_float(a));
-
-    int16_t a2 = (int32_t)a * a >> 15; // q1.15
-    // int16_t u = log((1.0 + sqrt(1.0 + ep * ep)) / ep); //smaller than 2,
-    // maybe q2.14 int16_t su = sinh(u / n); // in [0, 2] use a lookup table,
-    // maybe from 0 to 1 for resolution int16_t cu = cosh(u / n); // in [0, 2]
-    // use a lookup table, maybe from 0 to 1 for resolution
-    int16_t u = lookup_table_interpolate(u_wave_table, ep, 14); // Q2.14
-    // printf("u %f\n", q2_14_to_float(u));
-    // printf("a2 %f\n", q1_15_to_float(a2));
-    int16_t su =
-        lookup_table_interpolate(sinh_wave_table, u / N_Cheb, 14); // Q2.14
-    // printf("su %f\n", q2_14_to_float(su));
-    int16_t cu =
-        lookup_table_interpolate(cosh_wave_table, u / N_Cheb, 14); // Q2.14
-
-    // printf("su %f\n", q2_14_to_float(su));
-    // printf("cu %f\n", q2_14_to_float(cu));
+    float a = tanf((float)M_PI * fc / fs);
+    float a2 = a * a;
+    float u = logf((1.f + sqrtf(1.f + epsilon * epsilon)) / epsilon);
+    float su = sinhf(u / N_Cheb);
+    float cu = coshf(u / N_Cheb);
 
+    ChebCoefficients &set = designs.edit();
     for (int i = 0; i < m; ++i) {
-        // But we don't need to multiply by 2Pi since our wave table is sampled
-        // by x*2*pi
-        int16_t z = ((int32_t)(2 * i + 1) * (1 << 13) / N_Cheb);
-        // printf("i = %d z_su = %f\n", z_su, q1_15_to_float(z_su));
-        // printf("i = %d z_cu = %f\n", i, q1_15_to_float(z_cu));
-        int16_t b =
-            (int32_t)lookup_table_interpolate(sine_wave_table, z, 15) * su >>
-            14;
-        //
-        // b = ;
-        // printf("i = %d b = %f\n", i, q1_15_to_float(b));
-        int16_t c =
-            (int32_t)lookup_table_interpolate(cos_wave_table, z, 15) * cu >> 14;
-
-        // printf("i = %d c = %f\n", i, q1_15_to_float(c));
-        c = ((int32_t)b * b + (int32_t)c * c) >>
-            16; // this can overflow I think
-
-        // printf("i = %d c_2 = %f\n", i, q2_14_to_float(c));
-
-        int16_t a2_c = ((int32_t)a2 * c) >> 14;    // q1.15
-        int16_t ab_2 = 2 * ((int32_t)a * b) >> 15; // q1.15
-
-        // s = ((int32_t) a2 * c) >> 15  //q2.30 -> q1.15*q2.14 = q3.29
-        //     + (((int32_t) a * b) >> 14 ) *2  //q2.30
-        //   + (1 << 14); //q2.14
-        int16_t s = (1 << 14);
-        s += a2_c >> 1; // q2.30 -> q1.15*q2.14 = q3.29
-        s += ab_2 >> 1; // q2.30
-
-        // printf("i = %d s = %f\n", i, q2_14_to_float(s));
-        A[i] = (((int32_t)a2 << 14) / s) >> 2;          // 4.0 q1.15
-        d1[i] = 2 * (((1 << 15) - a2_c) << 13) / s;     // q2.14
-        d2[i] = (-(a2_c - ab_2 + (1 << 15)) << 14) / s; // q1.15
-        // printf("i = %d, A[i] = %lf, d1[i] = %lf, d2[i] = %lf\n", i,
-        //        q1_15_to_float(A[i]), q2_14_to_float(d1[i]),
-        //        q1_15_to_float(d2[i]));
+        // Lowest Q first, so the resonant sections see a smooth signal
+        int pole = m - 1 - i;
+        float angle = (float)M_PI * (2 * pole + 1) / (2 * N_Cheb);
+        float b = sinf(angle) * su;
+        float c = cosf(angle) * cu;
+        c = b * b + c * c;
+        float s = a2 * c + 2.f * a * b + 1.f;
+        float g = a2 * c / s;     // (1 - d1 - d2) / 4
+        float e = 2.f * a * b / s; // (1 + d2) / 2
+        float h = 1.f / s;        // (1 + d1 - d2) / 4
+
+        ChebSection &section = set.sections[i];
+        ChebForm &dc = section.forms[CHEB_AROUND_DC];
+        cheb_mantissa(g, dc.c1, dc.c1_shift);
+        cheb_mantissa(e, dc.c2, dc.c2_shift);
+        ChebForm &nyquist = section.forms[CHEB_AROUND_NYQUIST];
+        cheb_mantissa(h, nyquist.c1, nyquist.c1_shift);
+        cheb_mantissa(e, nyquist.c2, nyquist.c2_shift);
+        // Poles past a quarter of the sample rate (d1 < 0) are closer to
+        // Nyquist
+        section.form = h < g ? CHEB_AROUND_NYQUIST : CHEB_AROUND_DC;
     }
+
+    set.serial = ++serial;
+    designs.publish();
 }
 
-int16_t FilterCheb::che_low_pass(int16_t x) {
-    // ep is q2.14
-    // x is q1.15
-    // d1 is q2.14
-    // d2 is q1.15
-    // A is q1.15
-    // maybe w should be q2.14, I don't really know
-    // maybe q4.12 to play it safe, we can try and see if it works
+void FilterCheb::reset() {
     for (int i = 0; i < m; ++i) {
-        int16_t d1w1 = ((int32_t)d1[i] * w1[i]) >> 14; // q4.12
-        int16_t d2w2 = ((int32_t)d2[i] * w2[i]) >> 15; // q4.12
-        w0[i] = d1w1 + d2w2 + (x >> 3); // this does not feel right, if x is
-                                        // small this will kill it
-        x = ((int32_t)A[i] * (w0[i] + 2 * w1[i] + w2[i])) >> 12;
-        w2[i] = w1[i];
-        w1[i] = w0[i];
-        // x = (x <<);
+        states[i] = {};
     }
-    return x;
 }
 
+// c * w / 2^shift rounded down, for 0 <= c < 2^16, |w| < 2^30 and
+// 16 <= shift <= CHEB_MAX_SHIFT, with two 32-bit multiplies like
+// mul_shift_carry(), the low one unsigned. The fraction dropped goes into
+// the next two products, so the rounding error comes out shaped by
+// (1 - z^-1)^2 around DC or (1 + z^-1)^2 around Nyquist. That is zero where
+// the poles of the section sit and cancels the double sum the recursion
+// takes of it.
+template <ChebFormType form>
+static inline int32_t cheb_product(int32_t c, int32_t w, int shift,
+                                   int32_t *err) {
+    int32_t hi = c * (w >> 16);
+    // The low half keeps its own remainder, or the floor would bias a
+    // product that stays small for long
+    uint32_t low = (uint32_t)c * (uint32_t)(w & 0xFFFF) + (uint32_t)err[2];
+    int32_t lo = (int32_t)(low >> 16);
+    err[2] = (int32_t)(low & 0xFFFF);
+    int32_t carry =
+        form == CHEB_AROUND_DC ? 2 * err[0] - err[1] : -2 * err[0] - err[1];
+    int32_t fine = hi + lo + carry;
+    int32_t result = fine >> (shift - 16);
+    err[1] = err[0];
+    err[0] = fine - (result << (shift - 16));
+    return result;
+}
+
+// One section over the whole block in place, its state in locals. With
+// glide, the mantissas are Q15 and move by dc1 and dc2 each sample.
+template <ChebFormType form, bool glide>
+static void cheb_section(int32_t *x, size_t size, ChebState &state,
+                         ChebPlan plan) {
+    int32_t x1 = state.x1, x2 = state.x2, y1 = state.y1, y2 = state.y2;
+    int32_t err1[3] = {state.err1[0], state.err1[1], state.err1[2]};
+    int32_t err2[3] = {state.err2[0], state.err2[1], state.err2[2]};
+    for (size_t n = 0; n < size; n++) {
+        if (glide) {
+            plan.c1 += plan.dc1;
+            plan.c2 += plan.dc2;
+        }
+        const int32_t c1 = glide ? plan.c1 >> 15 : plan.c1;
+        const int32_t c2 = glide ? plan.c2 >> 15 : plan.c2;
+        const int32_t x0 = x[n];
+        const int32_t sum = x0 + 2 * x1 + x2;
+        int32_t y0;
+        if (form == CHEB_AROUND_DC) {
+            y0 = 2 * y1 - y2 +
+                 cheb_product<form>(c1, sum - 4 * y1, plan.c1_shift, err1) -
+                 cheb_product<form>(c2, 2 * (y1 - y2), plan.c2_shift, err2);
+        } else {
+            y0 = sum - 2 * y1 - y2 +
+                 cheb_product<form>(c1, 4 * y1 - sum, plan.c1_shift, err1) +
+                 cheb_product<form>(c2, 2 * (y1 + y2) - sum, plan.c2_shift,
+                                    err2);
+        }
+        x2 = x1;
+        x1 = x0;
+        y2 = y1;
+        y1 = y0;
+        x[n] = y0;
+    }
+    state = {x1, x2, y1, y2, {err1[0], err1[1], err1[2]},
+             {err2[0], err2[1], err2[2]}};
+}
+
+// Q15 start and per sample step of a mantissa gliding from a to b over size
+// samples, both at the smaller of their shifts
+static void cheb_glide(int32_t a, int a_shift, int32_t b, int b_shift,
+                       size_t size, int32_t &start, int32_t &step,
+                       int &shift) {
+    shift = std::min(a_shift, b_shift);
+    a >>= a_shift - shift;
+    b >>= b_shift - shift;
+    start = a * 32768;
+    step = (b - a) * 32768 / (int32_t)size;
+}
+
+// Bring the carries of a product to another shift. What falls off going
+// down is far below the sample LSB. The low half does not depend on it.
+static void cheb_rescale(int32_t *err, int from, int to) {
+    for (int k = 0; k < 2; k++)
+        err[k] = to < from ? err[k] >> (from - to) : err[k] << (to - from);
+}
+
+template <bool glide>
+static void cheb_run(int32_t *x, size_t size, ChebState &state,
+                     ChebFormType form, const ChebPlan &plan) {
+    if (form == CHEB_AROUND_DC)
+        cheb_section<CHEB_AROUND_DC, glide>(x, size, state, plan);
+    else
+        cheb_section<CHEB_AROUND_NYQUIST, glide>(x, size, state, plan);
+}
 
 void FilterCheb::out(int16_t *samples, size_t size) {
-    for (size_t i = 0; i < size; i++) {
-        samples[i] = che_low_pass(samples[i]);
+    // One coefficient set per block
+    const ChebCoefficients &next = designs.read();
+    const bool glide = next.serial != current.serial;
+
+    int32_t *x = work.data();
+    for (size_t n = 0; n < size; n++)
+        x[n] = samples[n] * (1 << CHEB_FRAC_BITS);
+
+    for (int i = 0; i < m; ++i) {
+        const ChebSection &a = current.sections[i];
+        ChebState &state = states[i];
+        if (!glide) {
+            const ChebForm &f = a.forms[a.form];
+            cheb_run<false>(x, size, state, a.form,
+                            {f.c1, f.c2, 0, 0, f.c1_shift, f.c2_shift});
+            continue;
+        }
+
+        // Glide sample by sample in the form of the new set, at the smaller
+        // scale of both, which suits either. Every point on the way is a
+        // stable section, the stable region is convex in the coefficients
+        // of either form.
+        const ChebSection &b = next.sections[i];
+        const ChebForm &from = a.forms[b.form], &to = b.forms[b.form];
+        if (a.form != b.form) {
+            // The carries only mean something in the form they came from,
+            // dropping them moves the output by less than its LSB
+            state.err1[0] = state.err1[1] = 0;
+            state.err2[0] = state.err2[1] = 0;
+        }
+        ChebPlan plan;
+        cheb_glide(from.c1, from.c1_shift, to.c1, to.c1_shift, size, plan.c1,
+                   plan.dc1, plan.c1_shift);
+        cheb_glide(from.c2, from.c2_shift, to.c2, to.c2_shift, size, plan.c2,
+                   plan.dc2, plan.c2_shift);
+        cheb_rescale(state.err1, from.c1_shift, plan.c1_shift);
+        cheb_rescale(state.err2, from.c2_shift, plan.c2_shift);
+        cheb_run<true>(x, size, state, b.form, plan);
+        cheb_rescale(state.err1, plan.c1_shift, to.c1_shift);
+        cheb_rescale(state.err2, plan.c2_shift, to.c2_shift);
+    }
+    if (glide)
+        current = next;
+
+    for (size_t n = 0; n < size; n++) {
+        int32_t y = (x[n] + (1 << (CHEB_FRAC_BITS - 1))) >> CHEB_FRAC_BITS;
+        samples[n] = y > INT16_MAX ? INT16_MAX : (y < INT16_MIN ? INT16_MIN : y);
     }
 }
+
+const char *svf_mode_to_string(SvfMode mode) {
+    switch (mode) {
+    case SVF_LOW_PASS:
+        return "LP";
+    case SVF_BAND_PASS:
+        return "BP";
+    case SVF_HIGH_PASS:
+        return "HP";
+    default:
+        return "Unknown";
+    }
+}
+
+// Split v > 0, a fixed-point value with frac fractional bits, into a
+// mantissa in [2^14, 2^15) and a right shift
+static void fixed_to_mantissa(uint32_t v, int frac, int32_t &mantissa,
+                              int &shift) {
+    int bits = 32 - __builtin_clz(v);
+    mantissa = bits > 15 ? v >> (bits - 15) : v << (15 - bits);
+    shift = frac - (bits - 15);
+}
+
+FilterSVF::FilterSVF(float fc, float q, SvfMode mode) : mode(mode) {
+    set_resonance(q);
+    set_cutoff_freq(fc);
+}
+
+void FilterSVF::set_cutoff_freq(float fc) {
+    fc = fc < 1.f ? 1.f : fc;
+    set_cutoff_note((int32_t)((69.f + 12.f * log2f(fc / 440.f)) * 256.f));
+}
+
+void FilterSVF::set_cutoff_note(int32_t note_q8) {
+    const int32_t lowest = SVF_FIRST_NOTE << 8;
+    const int32_t highest = (SVF_FIRST_NOTE + SVF_TABLE_LEN - 1) << 8;
+    cutoff_note = note_q8 < lowest ? lowest
+                                   : (note_q8 > highest ? highest : note_q8);
+    update_coefficients();
+}
+
+float FilterSVF::get_cutoff() const {
+    return 440.f * exp2f((cutoff_note / 256.f - 69.f) / 12.f);
+}
+
+void FilterSVF::set_resonance(float q) {
+    q = q < SVF_MIN_Q ? SVF_MIN_Q : (q > SVF_MAX_Q ? SVF_MAX_Q : q);
+    set_damping(q24_from_float(1.f / q));
+}
+
+void FilterSVF::set_damping(q8_24_t damping) {
+    const q8_24_t lowest = (q8_24_t)(Q24_ONE / SVF_MAX_Q);
+    const q8_24_t highest = (q8_24_t)(Q24_ONE / SVF_MIN_Q);
+    damping = damping < lowest ? lowest
+                               : (damping > highest ? highest : damping);
+    if (damping == r)
+        return;
+    r = damping;
+    update_coefficients();
+}
+
+void FilterSVF::update_coefficients() {
+    // g between two notes of the table, linear in the Q8 fraction
+    int32_t index = (cutoff_note >> 8) - SVF_FIRST_NOTE;
+    int32_t frac = cutoff_note & 0xFF;
+    q8_24_t g = svf_tan_table[index];
+    if (frac != 0)
+        g += ((svf_tan_table[index + 1] - g) * frac) >> 8;
+
+    q8_24_t gr = g + r;
+    // 1 + r g + g^2 stays under 11 in the table range. The divider gives
+    // 1 / den in Q16, plenty for a value between 0.1 and 1.
+    uint32_t den = Q24_ONE + (uint32_t)(((int64_t)g * gr) >> Q24_FRAC_BITS);
+    uint32_t d = 0xFFFFFFFFu / (den >> 8);
+
+    Coefficients c;
+    fixed_to_mantissa(g, Q24_FRAC_BITS, c.g, c.g_shift);
+    fixed_to_mantissa(gr, Q24_FRAC_BITS, c.gr, c.gr_shift);
+    fixed_to_mantissa(d, 16, c.d, c.d_shift);
+    fixed_to_mantissa(r, Q24_FRAC_BITS, c.r, c.r_shift);
+    designs.edit() = c;
+    designs.publish();
+}
+
+void FilterSVF::reset() {
+    s1 = 0;
+    s2 = 0;
+    err1 = 0;
+    err2 = 0;
+}
+
+void FilterSVF::out(int16_t *samples, size_t size) {
+    // One coefficient set per block, and the kernel picked once for it
+    const Coefficients c = designs.read();
+    switch (mode) {
+    case SVF_BAND_PASS:
+        kernel<SVF_BAND_PASS>(c, samples, size);
+        break;
+    case SVF_HIGH_PASS:
+        kernel<SVF_HIGH_PASS>(c, samples, size);
+        break;
+    default:
+        kernel<SVF_LOW_PASS>(c, samples, size);
+        break;
+    }
+}
+
+template <SvfMode out_mode>
+void FilterSVF::kernel(const Coefficients &c, int16_t *samples, size_t size) {
+    const int32_t gr_round = (1 << (c.gr_shift - 12)) >> 1;
+    const int32_t d_round = (1 << (c.d_shift - 12)) >> 1;
+    const int32_t r_round = (1 << (c.r_shift - 12)) >> 1;
+    const int32_t out_round = (1 << SVF_FRAC_BITS) >> 1;
+    int32_t state1 = s1;
+    int32_t state2 = s2;
+    int32_t carry1 = err1;
+    int32_t carry2 = err2;
+
+    for (size_t n = 0; n < size; n++) {
+        int32_t x = (int32_t)samples[n] << SVF_FRAC_BITS;
+        int32_t hp = mul_shift(
+            c.d, x - mul_shift(c.gr, state1, c.gr_shift, gr_round) - state2,
+            c.d_shift, d_round);
+        // At low cutoffs g x rounds to zero for small x and the
+        // integrators would stall short of their target, so the rounding
+        // of both is carried instead
+        int32_t v = mul_shift_carry(c.g, hp, c.g_shift, carry1);
+        int32_t bp = v + state1;
+        state1 = bp + v;
+        v = mul_shift_carry(c.g, bp, c.g_shift, carry2);
+        int32_t lp = v + state2;
+        state2 = lp + v;
+
+        int32_t y;
+        if constexpr (out_mode == SVF_LOW_PASS) {
+            y = lp;
+        } else if constexpr (out_mode == SVF_BAND_PASS) {
+            y = mul_shift(c.r, bp, c.r_shift, r_round);
+        } else {
+            y = hp;
+        }
+        // A resonating filter can go over full scale
+        y = (y + out_round) >> SVF_FRAC_BITS;
+        if (y > INT16_MAX)
+            y = INT16_MAX;
+        if (y < INT16_MIN)
+            y = INT16_MIN;
+        samples[n] = y;
+    }
+    s1 = state1;
+    s2 = state2;
+    err1 = carry1;
+    err2 = carry2;
+}
+
+void HalfbandDecimator::decimate(int16_t *buffer, size_t size, int32_t *out) {
+    int16_t *window = buffer - HALFBAND_HISTORY;
+    std::copy(history.begin(), history.end(), window);
+
+    const int16_t *h = halfband_table.data();
+    for (size_t n = 0; n < size; n++) {
+        // The HALFBAND_TAPS samples ending at input 2n + 1, centre at
+        // p[HALFBAND_HISTORY / 2]
+        const int16_t *p = window + 2 * n + 1;
+        const int16_t *lo = p + HALFBAND_HISTORY / 2 - 1;
+        const int16_t *hi = p + HALFBAND_HISTORY / 2 + 1;
+        int32_t sum = (int32_t)p[HALFBAND_HISTORY / 2] << 14;
+        for (int j = 0; j < HALFBAND_PAIRS; j++) {
+            sum += (lo[-2 * j] + hi[2 * j]) * h[j];
+        }
+        out[n] += (sum + (1 << 14)) >> 15;
+    }
+
+    std::copy(window + 2 * size, window + 2 * size + HALFBAND_HISTORY,
+              history.begin());
+}
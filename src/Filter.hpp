@@ -1,6 +1,7 @@
 #ifndef FILTER_HPP
 #define FILTER_HPP
 
+#include "TripleBuffer.hpp"
 #include "Wavetable.hpp"
 #include "config.hpp"
 #include "fixed_point.h"
@@ -8,6 +9,26 @@
 #include <cstddef>
 #include <cstdint>
 
+// Above FIR_SHORT_CUTOFF Hz the FIR runs with FIR_SHORT_TAPS taps. The
+// Hann window is sampled from the FILTER_ORDER one, so
+// (FILTER_ORDER - 1) / (FIR_SHORT_TAPS - 1) must be a whole number.
+#define FIR_SHORT_TAPS 17
+#define FIR_SHORT_CUTOFF 8000.f
+
+// FIR cutoffs are quantized to FIR_CUTOFF_STEP Hz, one encoder detent, and
+// the last FIR_BANK_SLOTS coefficient sets are kept for reuse
+#define FIR_CUTOFF_STEP 50
+#define FIR_BANK_SLOTS 8
+
+// One coefficient set of the FIR bank
+struct FirCoefficients {
+    int cutoff_index = -1; // cutoff / FIR_CUTOFF_STEP, -1 while empty
+    int num_taps = FILTER_ORDER; // odd, only the first num_taps are valid
+    uint32_t last_used = 0;
+    std::array<q8_24_t, FILTER_ORDER> h = {0};       // filter coefficients
+    std::array<int16_t, FILTER_ORDER> h_q2_14 = {0}; // filter coefficients
+};
+
 #define N_Cheb 8
 #define m N_Cheb / 2
 
@@ -15,9 +36,20 @@ enum FilterType {
     FILTER_OFF,
     FILTER_LOW_PASS,
     FILTER_CHEBYSHEV,
+    FILTER_SVF,
     NUM_FILTER_TYPES
 };
 
+// Output taken from the state variable filter
+enum SvfMode {
+    SVF_LOW_PASS,
+    SVF_BAND_PASS, // unity gain at the cutoff
+    SVF_HIGH_PASS,
+    NUM_SVF_MODES
+};
+
+const char *svf_mode_to_string(SvfMode mode);
+
 template <typename T> inline void reverse_array(T *array, size_t size) {
     if (size <= 1)
         return; // Nothing to reverse
@@ -48,14 +80,17 @@ template <typename T> inline void reverse_array(T *array, size_t size) {
 class FilterFIR {
   public:
     FilterFIR(float freq_c);
-    FilterFIR(FilterFIR &&) = default;
-    FilterFIR(const FilterFIR &) = default;
-    FilterFIR &operator=(FilterFIR &&) = default;
-    FilterFIR &operator=(const FilterFIR &) = default;
     ~FilterFIR() = default;
 
+    // Only records the new cutoff, update_coefficients() designs for it.
+    // Synth calls that at most once per block, from update_params().
     void set_cutoff_freq(float freq_c);
     float get_cutoff(){return q16_to_float(cutoff_freq);}
+    // Bring the coefficients in line with the last cutoff, from a cached
+    // set if possible. Call outside the render path; out() picks the new
+    // set up at its next block.
+    void update_coefficients();
+    const FirCoefficients &get_coefficients() const { return *latest; }
 
     // Process a single sample
     int16_t process(int16_t sample);
@@ -67,65 +102,180 @@ class FilterFIR {
     // Process array of samples in-place (more efficient)
     void processChunkInPlace(int16_t *samples, size_t size);
 
-    std::array<int16_t, SAMPLES_PER_BUFFER> &get_output();
-
     void reset();
-    void recalculate_coefficients();
-    std::array<q8_24_t, FILTER_ORDER> h = {0};       // filter coefficients
-    std::array<int16_t, FILTER_ORDER> h_q2_14 = {0}; // filter coefficients
 
   private:
-    // Filter state
-    std::array<int16_t, FILTER_ORDER> buffer = {0};
-    int buffer_index = 0;
-    std::array<int16_t, SAMPLES_PER_BUFFER> output = {};
-    std::array<int16_t, SAMPLES_PER_BUFFER> *in_signal;
+    // Fill slot with the windowed-sinc for cutoff_index
+    static void compute_coefficients(FirCoefficients &slot, int cutoff_index);
+
+    // Store a sample and return the FILTER_ORDER newest ones, oldest first
+    const int16_t *push(int16_t sample);
+
+    // Filter state. Every sample is written twice, FILTER_ORDER apart, so
+    // the newest FILTER_ORDER samples are contiguous and never wrap.
+    std::array<int16_t, 2 * FILTER_ORDER> delay = {0};
+    int pos = 0;
+
+    // Sets designed lately, owned by update_coefficients(). The one in use
+    // goes to out() as a copy, so a block never sees half of an update.
+    std::array<FirCoefficients, FIR_BANK_SLOTS> bank;
+    const FirCoefficients *latest = nullptr;
+    TripleBuffer<FirCoefficients> active;
+    int pending_index = 0;
+    uint32_t use_count = 0;
 
     q16_16_t cutoff_freq;
-    q8_24_t fc_norm; // normalized cutoff frequency
+};
+
+// One biquad of the Chebyshev cascade, direct form I written around its
+// poles so the small coefficients keep their precision. Below a quarter of
+// the sample rate the poles sit near DC:
+//   y0 = 2 y1 - y2 + g (s - 4 y1) - 2 e (y1 - y2)
+// above it near Nyquist:
+//   y0 = s - 2 y1 - y2 + h (4 y1 - s) + e (2 (y1 + y2) - s)
+// with s = x0 + 2 x1 + x2, g = (1 - d1 - d2) / 4, e = (1 + d2) / 2 and
+// h = (1 + d1 - d2) / 4. Every product is zero on a constant signal, so the
+// gain at DC is exactly one whatever the rounding of the coefficients.
+// Those are 16-bit mantissas with a right shift each, as the SVF keeps its
+// own, and each product is two 32-bit multiplies.
+enum ChebFormType { CHEB_AROUND_DC, CHEB_AROUND_NYQUIST };
+
+// The two coefficients of one form, g and e or h and e
+struct ChebForm {
+    int32_t c1, c2;
+    int c1_shift, c2_shift;
+};
+
+struct ChebSection {
+    ChebForm forms[2]; // both, a glide may need the one not run
+    ChebFormType form; // the one run
+};
+
+struct ChebCoefficients {
+    ChebSection sections[m];
+    uint32_t serial = 0; // changes with every new design
+};
+
+// State of one section, its last two inputs and outputs and, for each of
+// its two products, what the shift dropped on the last two samples and
+// what the low half of the multiply still holds
+struct ChebState {
+    int32_t x1, x2, y1, y2;
+    int32_t err1[3], err2[3];
+};
+
+// Coefficients of one section as a block runs them. While gliding c1 and c2
+// are Q15 mantissas and move by dc1 and dc2 every sample.
+struct ChebPlan {
+    int32_t c1, c2, dc1, dc2;
+    int c1_shift, c2_shift;
 };
 
 class FilterCheb {
   public:
-    FilterCheb(float fc, float epsilon, float fs);
-    FilterCheb(FilterCheb &&) = default;
-    FilterCheb(const FilterCheb &) = default;
-    FilterCheb &operator=(FilterCheb &&) = default;
-    FilterCheb &operator=(const FilterCheb &) = default;
+    FilterCheb(float fc, float epsilon);
     ~FilterCheb() = default;
 
+    // Design a new set, outside the render path. out() glides to it over
+    // its next block, so the cutoff can move every block without clicks.
     void set_cutoff_freq(float fc, float epsilon);
     float get_cutoff() { return q16_to_float(cutoff_freq); }
-    // Process a single sample
-    int16_t process(int16_t sample);
+    // At most SAMPLES_PER_BUFFER samples
     void out(int16_t *samples, size_t size);
 
-    // Process a chunk of samples at once
-    // std::vector<int16_t> processChunk(const std::vector<int16_t>& input);
+    void reset();
 
-    // Process array of samples in-place (more efficient)
-    void processChunkInPlace(int16_t *samples, size_t size);
-    int16_t che_low_pass(int16_t x);
+  private:
+    q16_16_t cutoff_freq;
+
+    // Written by set_cutoff_freq(), out() takes the newest
+    TripleBuffer<ChebCoefficients> designs;
+    uint32_t serial = 0;
+
+    // Owned by out()
+    ChebCoefficients current;
+    ChebState states[m] = {};
+    // The block between two sections, as samples with fractional bits
+    std::array<int32_t, SAMPLES_PER_BUFFER> work;
+};
+
+// Samples kept from the previous block by HalfbandDecimator
+#define HALFBAND_HISTORY (HALFBAND_TAPS - 1)
 
-    std::array<int16_t, SAMPLES_PER_BUFFER> &get_output();
+// Polyphase 2:1 decimator with the half-band in halfband_table. Of each
+// pair of input samples only the even one goes through the folded taps,
+// the odd one meets the centre tap alone, so an output sample costs
+// HALFBAND_PAIRS multiplies.
+class HalfbandDecimator {
+  public:
+    // Filter 2 * size samples at buffer down to size samples, added to
+    // the 32-bit bus at out, which takes any ringing whole. buffer must
+    // have HALFBAND_HISTORY writable samples in front of it, they are
+    // filled with the end of the last block.
+    void decimate(int16_t *buffer, size_t size, int32_t *out);
+    void reset() { history.fill(0); }
+
+  private:
+    std::array<int16_t, HALFBAND_HISTORY> history = {0};
+};
+
+// Samples in the state variable filter carry SVF_FRAC_BITS below the int16
+// LSB. Q is limited so a resonating band pass still fits its states.
+#define SVF_FRAC_BITS 3
+#define SVF_MIN_Q 0.5f
+#define SVF_MAX_Q 20.f
+
+// Trapezoidal (TPT) state variable filter, stays stable and in tune up to
+// the top of its table. Per sample, with g = tan(pi fc / fs), r = 1 / Q:
+//   hp = (x - (r + g) s1 - s2) / (1 + r g + g^2)
+//   bp = g hp + s1,  s1 = bp + g hp
+//   lp = g bp + s2,  s2 = lp + g bp
+// Retuning is a table lookup and one divide, cheap enough to modulate the
+// cutoff every block. The setters design a new set and out() takes the
+// newest at its next block, so they may run on another core, one caller
+// at a time.
+class FilterSVF {
+  public:
+    FilterSVF() : FilterSVF(1000.f) {}
+    FilterSVF(float fc, float q = 0.707f, SvfMode mode = SVF_LOW_PASS);
+    ~FilterSVF() = default;
+
+    void set_cutoff_freq(float fc);
+    // Cutoff as a MIDI note in Q8, clamped to the table. No floats.
+    void set_cutoff_note(int32_t note_q8);
+    float get_cutoff() const;
+    void set_resonance(float q);
+    // 1 / Q in Q24, clamped like set_resonance(). No floats.
+    void set_damping(q8_24_t damping);
+    float get_resonance() const { return 1.f / q24_to_float(r); }
+    void set_mode(SvfMode new_mode) { mode = new_mode; }
+    SvfMode get_mode() const { return mode; }
+
+    void out(int16_t *samples, size_t size);
 
     void reset();
-    void recalculate_coefficients();
 
   private:
-    // Filter state
-    std::array<int16_t, SAMPLES_PER_BUFFER> output = {};
-    std::array<int16_t, SAMPLES_PER_BUFFER> *in_signal;
+    // 15-bit mantissas with their right shifts
+    struct Coefficients {
+        int32_t g, gr, d, r; // g, r + g, 1 / (1 + r g + g^2), r
+        int g_shift, gr_shift, d_shift, r_shift;
+    };
 
-    q16_16_t cutoff_freq;
-    q8_24_t fc_norm; // normalized cutoff frequency
-    //
-    int16_t A[m] = {0};
-    int16_t d1[m] = {0};
-    int16_t d2[m] = {0};
-    int16_t w0[m] = {0};
-    int16_t w1[m] = {0};
-    int16_t w2[m] = {0};
+    void update_coefficients();
+    template <SvfMode out_mode>
+    void kernel(const Coefficients &c, int16_t *samples, size_t size);
+
+    int32_t cutoff_note = SVF_FIRST_NOTE << 8;
+    q8_24_t r = Q24_ONE; // 1 / Q
+    SvfMode mode = SVF_LOW_PASS;
+    TripleBuffer<Coefficients> designs;
+
+    // Trapezoidal integrator states, and the rounding carried into them
+    int32_t s1 = 0;
+    int32_t s2 = 0;
+    int32_t err1 = 0;
+    int32_t err2 = 0;
 };
 
 #endif // FILTER_HPP
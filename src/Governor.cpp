@@ -0,0 +1,110 @@
+#include "Governor.hpp"
+#include "Synth.hpp"
+#include <cstdio>
+
+const char *governor_level_to_string(RenderGovernor::Level level) {
+    switch (level) {
+    case RenderGovernor::GOV_NORMAL:
+        return "Normal";
+    case RenderGovernor::GOV_VOICES_LIMITED:
+        return "Voices limited";
+    case RenderGovernor::GOV_INTERP_DROPPED:
+        return "Interp dropped";
+    case RenderGovernor::GOV_FILTER_BYPASSED:
+        return "Filter bypassed";
+    default:
+        return "Unknown";
+    }
+}
+
+RenderGovernor::RenderGovernor(Synth &synth) : synth(synth) {}
+
+void RenderGovernor::update(uint32_t render_us, uint32_t deadline_us) {
+    if (deadline_us == 0)
+        return;
+
+    int32_t load = static_cast<int32_t>(render_us * 1000 / deadline_us);
+    load_avg += (load - load_avg) >> 3;
+
+    counters.buffers++;
+    counters.load_avg = static_cast<uint16_t>(load_avg);
+    if (load > counters.load_peak)
+        counters.load_peak = static_cast<uint16_t>(load);
+
+    if (hold > 0)
+        hold--;
+
+    // A missed deadline sheds a step straight away, a high average only
+    // once the previous step has had time to show its effect
+    if (render_us > deadline_us) {
+        counters.overruns++;
+        degrade();
+    } else if (hold == 0 && load_avg > LOAD_HIGH) {
+        degrade();
+    } else if (hold == 0 && load_avg < LOAD_LOW) {
+        restore();
+    }
+}
+
+void RenderGovernor::degrade() {
+    if (level == GOV_FILTER_BYPASSED)
+        return;
+
+    level = static_cast<Level>(level + 1);
+    switch (level) {
+    case GOV_VOICES_LIMITED:
+        synth.set_voice_limit(NUM_OSC * 3 / 4);
+        break;
+    case GOV_INTERP_DROPPED:
+        saved_interp = synth.get_interp_mode();
+        synth.set_interp_mode(INTERP_TRUNCATE);
+        break;
+    case GOV_FILTER_BYPASSED:
+        synth.set_filter_bypass(true);
+        break;
+    default:
+        break;
+    }
+    counters.degrades[level]++;
+    hold = HOLD_BUFFERS;
+}
+
+void RenderGovernor::restore() {
+    if (level == GOV_NORMAL)
+        return;
+
+    switch (level) {
+    case GOV_VOICES_LIMITED:
+        synth.set_voice_limit(NUM_OSC);
+        break;
+    case GOV_INTERP_DROPPED:
+        synth.set_interp_mode(saved_interp);
+        break;
+    case GOV_FILTER_BYPASSED:
+        synth.set_filter_bypass(false);
+        break;
+    default:
+        break;
+    }
+    counters.restores[level]++;
+    level = static_cast<Level>(level - 1);
+    hold = HOLD_BUFFERS;
+}
+
+void RenderGovernor::reset_counters() {
+    counters = {};
+    counters.load_avg = static_cast<uint16_t>(load_avg);
+}
+
+void RenderGovernor::print_stats() const {
+    printf("Governor: %s, load avg %u/1000, peak %u/1000\n",
+           governor_level_to_string(level), counters.load_avg,
+           counters.load_peak);
+    printf("  buffers %lu, overruns %lu\n", counters.buffers,
+           counters.overruns);
+    for (int i = GOV_VOICES_LIMITED; i < NUM_GOV_LEVELS; i++) {
+        printf("  %-16s entered %lu, left %lu\n",
+               governor_level_to_string(static_cast<Level>(i)),
+               counters.degrades[i], counters.restores[i]);
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef GOVERNOR_HPP
+#define GOVERNOR_HPP
+
+#include "Oscillator.hpp"
+#include <cstdint>
+
+class Synth; // Forward declaration
+
+// Keeps Synth::out() inside the buffer deadline. Render time is tracked as
+// a moving average of the fraction of the deadline used. Under load the
+// governor sheds work one step at a time, and gives it back in reverse
+// order once the average has dropped well below the limit.
+class RenderGovernor {
+  public:
+    enum Level {
+        GOV_NORMAL,
+        GOV_VOICES_LIMITED,  // voices over the limit are stolen
+        GOV_INTERP_DROPPED,  // oscillators fall back to truncation
+        GOV_FILTER_BYPASSED, // global filter skipped
+        NUM_GOV_LEVELS
+    };
+
+    struct Counters {
+        uint32_t buffers;                  // renders measured
+        uint32_t overruns;                 // renders longer than the deadline
+        uint32_t degrades[NUM_GOV_LEVELS]; // times each level was entered
+        uint32_t restores[NUM_GOV_LEVELS]; // times each level was left
+        uint16_t load_avg;                 // per mille of the deadline
+        uint16_t load_peak;                // per mille of the deadline
+    };
+
+    RenderGovernor(Synth &synth);
+
+    // Feed the time the last render took and the time it had
+    void update(uint32_t render_us, uint32_t deadline_us);
+
+    Level get_level() const { return level; }
+    const Counters &get_counters() const { return counters; }
+    void reset_counters();
+    void print_stats() const;
+
+  private:
+    void degrade();
+    void restore();
+
+    Synth &synth;
+    Level level = GOV_NORMAL;
+    int32_t load_avg = 0; // per mille, exponential average over ~8 buffers
+    uint32_t hold = 0;    // buffers to wait before the next step
+    InterpMode saved_interp = INTERP_TRUNCATE;
+    Counters counters = {};
+
+    static constexpr int32_t LOAD_HIGH = 850;  // shed above this average
+    static constexpr int32_t LOAD_LOW = 600;   // restore below this average
+    static constexpr uint32_t HOLD_BUFFERS = 16; // let the average settle
+};
+
+const char *governor_level_to_string(RenderGovernor::Level level);
+
+#endif // !GOVERNOR_HPP
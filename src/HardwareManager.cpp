@@ -1,6 +1,7 @@
 #include "HardwareManager.hpp"
 #include "fixed_point.h"
 #include "ssd1306.h"
+#include <algorithm>
 #include <cstdio>
 
 uint8_t led_state_1 = 0xFF;
@@ -34,70 +35,54 @@ void init_encoder(Encoder *enc) {
 //     return quadrature_encoder_get_count(pio, sm);
 // }
 
-uint16_t scan_key_state(i2c_inst_t *i2c) {
-    uint16_t state = 0;
+bool submit_key_scan(I2cEngine &bus, uint8_t rows[4], I2cJob *job) {
+    if (bus.free_slots() < KEYPAD_SCAN_TRANSACTIONS)
+        return false;
 
+    job->failed = false;
+    job->remaining = KEYPAD_SCAN_TRANSACTIONS;
     for (int col = 0; col < 4; col++) {
         uint8_t data = 0xFF;
         data &= ~(1 << COL_PINS[col]); // Drive this column LOW
 
-        // Send to PCF8574
-        i2c_write_blocking(i2c, PCF8574_KEYPAD_ADDR, &data, 1, true);
-        // sleep_us(5); // let signals settle
+        // Read the rows back after a repeated start
+        bus.submit(PCF8574_KEYPAD_ADDR, &data, 1, &rows[col], 1, job);
+    }
 
-        // Read state
-        uint8_t val;
-        i2c_read_blocking(i2c, PCF8574_KEYPAD_ADDR, &val, 1, false);
+    // Reset PCF to default HIGH
+    uint8_t reset = 0xFF;
+    bus.submit(PCF8574_KEYPAD_ADDR, &reset, 1, nullptr, 0, job);
+    return true;
+}
 
+uint16_t decode_key_state(const uint8_t rows[4]) {
+    uint16_t state = 0;
+
+    for (int col = 0; col < 4; col++) {
         for (int row = 0; row < 4; row++) {
-            if (!(val & (1 << ROW_PINS[row]))) {
+            if (!(rows[col] & (1 << ROW_PINS[row]))) {
                 int key_index = row + col * 4;
                 state |= (1 << key_index);
             }
         }
     }
 
-    // Reset PCF to default HIGH
-    uint8_t reset = 0xFF;
-    i2c_write_blocking(i2c, PCF8574_KEYPAD_ADDR, &reset, 1, false);
-
-    // printf("scan_key_state result: 0x%04X\n", state);
+    // printf("decode_key_state result: 0x%04X\n", state);
     return state;
 }
 
-void update_led(i2c_inst_t *i2c, int key, bool on) {
+void update_led(int key, bool on) {
     uint8_t pin = LED_MAP[key];
-    uint8_t addr;
-    uint8_t *led_state;
-
-    if (key < 8) {
-        addr = PCF8574_LED_ADDR_1;
-        led_state = &led_state_1;
-    } else {
-        addr = PCF8574_LED_ADDR_2;
-        led_state = &led_state_2;
-        key -= 8;
-    }
+    uint8_t *led_state = key < 8 ? &led_state_1 : &led_state_2;
 
     if (on) {
         *led_state &= ~(1 << pin); // Active LOW: 0 = ON
     } else {
         *led_state |= (1 << pin); // 1 = OFF
     }
-
-    // Write updated state to PCF8574
-    uint8_t data = *led_state;
-    i2c_write_blocking(i2c, addr, &data, 1, false);
-    // int result = i2c_write_blocking(i2c, addr, &data, 1, false);
-    // if (result < 0) {
-    //     // printf("I2C write FAILED to 0x%02X\n", addr);
-    // } else {
-    //     printf("Wrote 0x%02X to PCF8574 @ 0x%02X\n", data, addr);
-    // }
 }
 
-void update_leds_from_keys(i2c_inst_t *i2c, uint16_t prev_state,
-                           uint16_t curr_state) {
+void update_leds_from_keys(uint16_t prev_state, uint16_t curr_state) {
     uint16_t changed = prev_state ^ curr_state;
 
     for (int i = 0; i < 16; ++i) {
@@ -105,7 +90,7 @@ void update_leds_from_keys(i2c_inst_t *i2c, uint16_t prev_state,
             bool pressed = curr_state & (1 << i);
             // printf("  Key %d %s\n", i, pressed ? "PRESSED" : "RELEASED");
 
-            update_led(i2c, i, pressed);
+            update_led(i, pressed);
         }
     }
 }
@@ -130,11 +115,17 @@ void HardwareManager::init() {
     //
     // // Init display
     init_display();
+
+    // The display setup above is the last blocking transfer, the buses
+    // are interrupt driven from here on
+    keypad_bus.init(i2c0);
+    panel_bus.init(i2c1);
+    submit_key_scan(keypad_bus, scan_rows, &scan_job);
 }
 
 void HardwareManager::init_display() {
     disp.external_vcc = false;
-    ssd1306_init(&disp, 128, 64, 0x3C, i2c1);
+    ssd1306_init(&disp, DISPLAY_WIDTH, DISPLAY_HEIGHT, DISPLAY_ADDR, i2c1);
     // ssd1306_hflip(&disp, 1);
     ssd1306_rotate(&disp, 1);
     ssd1306_clear(&disp);
@@ -146,6 +137,8 @@ void HardwareManager::init_display() {
 void HardwareManager::update() {
     poll_inputs();
     update_display();
+    flush_leds();
+    flush_display();
 }
 
 void HardwareManager::poll_inputs() {
@@ -169,16 +162,14 @@ void HardwareManager::handle_encoders() {
 
             case 1: {
                 q8_24_t increment = q24_from_float(.1f);
-                for (auto &env : synth.envelopes) {
-                    env.increment_ADSR(current_adsr_param,
-                                       delta > 0 ? increment : -increment);
-                }
+                synth.increment_ADSR(current_adsr_param,
+                                     delta > 0 ? increment : -increment);
                 adsr_dirty = true;
                 break;
             }
             case 2:
                 // Only adjust filter cutoff if not in FILTER_OFF mode
-                if (synth.current_filter_type != FILTER_OFF) {
+                if (synth.get_filter_type() != FILTER_OFF) {
                     float cut_off = synth.get_filter_cutoff();
                     float new_cut_off = cut_off + (delta > 0 ? 50.f : -50.f);
                     // Ensure cutoff stays within reasonable bounds
@@ -213,20 +204,37 @@ void HardwareManager::handle_encoders() {
 }
 
 void HardwareManager::handle_keypad() {
-    uint16_t curr = scan_key_state(i2c0);
+    // The scan runs in the background, pick it up once all of it is in
+    if (!scan_job.done())
+        return;
+    if (scan_job.failed) {
+        submit_key_scan(keypad_bus, scan_rows, &scan_job);
+        return;
+    }
+
+    uint16_t curr = decode_key_state(scan_rows);
+    submit_key_scan(keypad_bus, scan_rows, &scan_job);
+
     KeyChanges changes = compute_key_changes(prev_keys, curr);
-    update_leds_from_keys(i2c1, prev_keys, curr);
+    update_leds_from_keys(prev_keys, curr);
 
+    // Keys are played like MIDI notes, through the event queue, so the
+    // voices are only ever touched by the renderer
+    const uint32_t now = synth.get_sample_clock();
     for (int i = 0; i < 16; ++i) {
         if ((changes.note_on_mask >> i) & 1) {
             uint8_t note = key_to_midi[i];
-            if (note != 255)
-                synth.note_on(note, 127);
+            if (note != 255) {
+                const uint8_t packet[4] = {0x09, 0x90, note, 127};
+                synth.queue_midi_packet(packet, now);
+            }
         }
         if ((changes.note_off_mask >> i) & 1) {
             uint8_t note = key_to_midi[i];
-            if (note != 255)
-                synth.note_off(note, 0);
+            if (note != 255) {
+                const uint8_t packet[4] = {0x08, 0x80, note, 0};
+                synth.queue_midi_packet(packet, now);
+            }
         }
     }
 
@@ -234,7 +242,65 @@ void HardwareManager::handle_keypad() {
 }
 
 void HardwareManager::update_leds(uint16_t prev, uint16_t curr) {
-    update_leds_from_keys(i2c1, prev, curr); // use your existing helper
+    update_leds_from_keys(prev, curr); // use your existing helper
+}
+
+void HardwareManager::flush_leds() {
+    if (!led_job.done() || panel_bus.free_slots() < 2)
+        return;
+    if (led_job.failed) {
+        led_job.failed = false;
+        leds_stale = true;
+    }
+
+    // However many keys changed, each expander gets at most one write
+    const uint8_t state[2] = {led_state_1, led_state_2};
+    const uint8_t addr[2] = {PCF8574_LED_ADDR_1, PCF8574_LED_ADDR_2};
+    bool send[2];
+    uint8_t count = 0;
+    for (int i = 0; i < 2; i++) {
+        send[i] = leds_stale || state[i] != leds_sent[i];
+        count += send[i];
+    }
+    if (count == 0)
+        return;
+
+    // Counted before submitting, the first write may finish right away
+    led_job.remaining = count;
+    for (int i = 0; i < 2; i++) {
+        if (send[i]) {
+            panel_bus.submit(addr[i], &state[i], 1, nullptr, 0, &led_job);
+            leds_sent[i] = state[i];
+        }
+    }
+    leds_stale = false;
+}
+
+void HardwareManager::flush_display() {
+    // A frame drawn while the last one is still going out waits for it,
+    // only the newest is ever sent
+    if (!display_dirty || !display_job.done() || panel_bus.free_slots() < 2)
+        return;
+    display_dirty = false;
+
+    uint8_t col_start = 0;
+    if (disp.width == 64)
+        col_start = 32;
+    const uint8_t commands[] = {
+        0x00, // control byte, every byte after it is a command
+        0x21, col_start, (uint8_t)(col_start + disp.width - 1), // SET_COL_ADDR
+        0x22, 0, (uint8_t)(disp.pages - 1),                     // SET_PAGE_ADDR
+    };
+
+    display_frame[0] = 0x40;
+    std::copy(disp.buffer, disp.buffer + disp.bufsize, display_frame + 1);
+
+    display_job.failed = false;
+    display_job.remaining = 2;
+    panel_bus.submit(disp.address, commands, sizeof(commands), nullptr, 0,
+                     &display_job);
+    panel_bus.submit(disp.address, display_frame, disp.bufsize + 1, nullptr, 0,
+                     &display_job);
 }
 
 void HardwareManager::update_display() {
@@ -246,7 +312,7 @@ void HardwareManager::update_display() {
         changed = true;
     }
 
-    WaveType current = synth.oscillators[0].get_wave_type();
+    WaveType current = synth.get_wave_type();
     if (current != last_wave_type) {
         last_wave_type = current;
         draw_wave_type();
@@ -266,7 +332,7 @@ void HardwareManager::update_display() {
     }
 
     if (changed) {
-        ssd1306_show(&disp);
+        display_dirty = true; // sent by flush_display()
     }
 }
 
@@ -284,8 +350,12 @@ void HardwareManager::draw_wave_type() {
 void HardwareManager::draw_adsr() {
     ssd1306_clear_square(&disp, 0, 36, 128, 16); // 2 lines tall
 
+    // The values last set, the voices take them at their next block
+    const std::array<q8_24_t, 4> &adsr = synth.get_ADSR();
     char values[4][8];
-    synth.envelopes[0].get_ADSR_strings(values); // 2 decimal digits
+    for (int i = 0; i < 4; i++) {
+        snprintf(values[i], 8, "%.2f", q24_to_float(adsr[i])); // 2 digits
+    }
 
     // Draw parameter strings starting at x=8
     char line1[24], line2[24];
@@ -324,7 +394,7 @@ void HardwareManager::draw_filter() {
     char fc_value[32];
 
     // Display different information based on filter type
-    switch (synth.current_filter_type) {
+    switch (synth.get_filter_type()) {
     case FILTER_LOW_PASS:
         snprintf(fc_value, sizeof(fc_value), "LP: %.1f Hz",
                  synth.get_filter_cutoff());
@@ -333,6 +403,11 @@ void HardwareManager::draw_filter() {
         snprintf(fc_value, sizeof(fc_value), "Cheb: %.1f Hz",
                  synth.get_filter_cutoff());
         break;
+    case FILTER_SVF:
+        snprintf(fc_value, sizeof(fc_value), "SVF %s: %.1f Hz",
+                 svf_mode_to_string(synth.get_svf_mode()),
+                 synth.get_filter_cutoff());
+        break;
     default: // off
         snprintf(fc_value, sizeof(fc_value), "Filter: OFF");
         break;
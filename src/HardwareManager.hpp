@@ -1,6 +1,7 @@
 #ifndef HARDWARE_MANAGER
 #define HARDWARE_MANAGER
 
+#include "I2cEngine.hpp"
 #include "Synth.hpp"
 #include "hardware/i2c.h"
 #include "hardware/pio.h"
@@ -14,6 +15,9 @@
 #define PCF8574_LED_ADDR_1 0x20
 #define PCF8574_LED_ADDR_2 0x21
 #define NUM_ENCODERS 4
+#define DISPLAY_ADDR 0x3C
+#define DISPLAY_WIDTH 128
+#define DISPLAY_HEIGHT 64
 
 // Struct for each encoder's runtime state
 typedef struct {
@@ -39,12 +43,20 @@ void init_encoder(Encoder *enc);
 // Get count from the encoder
 // inline int32_t get_encoder_count(PIO pio, uint sm);
 
-uint16_t scan_key_state(i2c_inst_t *i2c);
+// Transactions in one keypad scan: a write and read per column, then the
+// write releasing the columns
+#define KEYPAD_SCAN_TRANSACTIONS 5
 
-void update_led(i2c_inst_t *i2c, int key, bool on);
+// Queue a full keypad scan on bus, the column reads land in rows
+bool submit_key_scan(I2cEngine &bus, uint8_t rows[4], I2cJob *job);
 
-void update_leds_from_keys(i2c_inst_t *i2c, uint16_t prev_state,
-                           uint16_t curr_state);
+// Pressed keys from the column reads of a finished scan
+uint16_t decode_key_state(const uint8_t rows[4]);
+
+// LED changes only touch the expander state, see HardwareManager::flush_leds
+void update_led(int key, bool on);
+
+void update_leds_from_keys(uint16_t prev_state, uint16_t curr_state);
 
 KeyChanges compute_key_changes(uint16_t prev_state, uint16_t curr_state);
 
@@ -70,10 +82,29 @@ class HardwareManager {
     WaveType last_wave_type = static_cast<WaveType>(-1);
     uint16_t prev_keys = 0;
 
+    // Keypad on i2c0, LEDs and display on i2c1, all off the main loop
+    I2cEngine keypad_bus;
+    I2cEngine panel_bus;
+
+    I2cJob scan_job;
+    uint8_t scan_rows[4] = {0xFF, 0xFF, 0xFF, 0xFF};
+
+    I2cJob led_job;
+    uint8_t leds_sent[2] = {0xFF, 0xFF}; // expander bytes last written
+    bool leds_stale = false;             // a write failed, send both again
+
+    // Frame in flight, behind the 0x40 data control byte. Drawing goes on
+    // in disp.buffer while it is sent.
+    I2cJob display_job;
+    uint8_t display_frame[1 + DISPLAY_WIDTH * DISPLAY_HEIGHT / 8];
+    bool display_dirty = false;
+
     // Helpers
     void handle_encoders();
     void handle_keypad();
     void update_leds(uint16_t prev, uint16_t curr);
+    void flush_leds();
+    void flush_display();
     void draw_notes();
     void draw_wave_type();
     void draw_adsr();
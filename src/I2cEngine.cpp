@@ -0,0 +1,159 @@
+#include "I2cEngine.hpp"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include <algorithm>
+
+// Engine of each controller, for the interrupt handlers
+static I2cEngine *engines[2] = {nullptr, nullptr};
+
+// Depth of the controller's TX and RX FIFOs
+static constexpr uint32_t FIFO_DEPTH = 16;
+
+void I2cEngine::irq0() { engines[0]->handle_irq(); }
+
+void I2cEngine::irq1() { engines[1]->handle_irq(); }
+
+void I2cEngine::init(i2c_inst_t *i2c_inst) {
+    i2c = i2c_inst;
+    i2c_hw_t *hw = i2c_get_hw(i2c);
+    const uint index = i2c_hw_index(i2c);
+    engines[index] = this;
+
+    hw->intr_mask = 0;
+    (void)hw->clr_intr;
+    // Refill with half the FIFO still queued, drain on every byte read
+    hw->tx_tl = FIFO_DEPTH / 2;
+    hw->rx_tl = 0;
+
+    const uint irq = index == 0 ? I2C0_IRQ : I2C1_IRQ;
+    irq_set_exclusive_handler(irq, index == 0 ? irq0 : irq1);
+    irq_set_enabled(irq, true);
+}
+
+bool I2cEngine::submit(uint8_t address, const uint8_t *write_data,
+                       size_t write_len, uint8_t *read_data, size_t read_len,
+                       I2cJob *job) {
+    Transaction *t = queue.acquire_write();
+    if (t == nullptr)
+        return false;
+
+    t->address = address;
+    t->write_len = write_len;
+    t->write_data = write_data;
+    if (write_len <= I2C_INLINE_BYTES) {
+        std::copy(write_data, write_data + write_len, t->inline_data);
+        t->write_data = t->inline_data;
+    }
+    t->read_len = read_len;
+    t->read_data = read_data;
+    t->job = job;
+    queue.commit_write();
+
+    // An idle controller has no interrupt coming to pick this up
+    uint32_t irq_state = save_and_disable_interrupts();
+    if (current == nullptr)
+        start_next();
+    restore_interrupts(irq_state);
+    return true;
+}
+
+void I2cEngine::start_next() {
+    i2c_hw_t *hw = i2c_get_hw(i2c);
+    current = queue.acquire_read();
+    if (current == nullptr) {
+        hw->intr_mask = 0;
+        return;
+    }
+
+    commands_sent = 0;
+    bytes_read = 0;
+    aborted = false;
+
+    // The target address can only change while the controller is off
+    hw->enable = 0;
+    hw->tar = current->address;
+    hw->enable = 1;
+
+    hw->intr_mask = I2C_IC_INTR_MASK_M_RX_FULL_BITS |
+                    I2C_IC_INTR_MASK_M_TX_ABRT_BITS |
+                    I2C_IC_INTR_MASK_M_STOP_DET_BITS;
+    fill_tx_fifo();
+}
+
+void I2cEngine::fill_tx_fifo() {
+    i2c_hw_t *hw = i2c_get_hw(i2c);
+    const uint32_t total = current->write_len + current->read_len;
+
+    bool fifo_full = false;
+    while (commands_sent < total) {
+        if (hw->txflr >= FIFO_DEPTH) {
+            fifo_full = true;
+            break;
+        }
+        uint32_t command;
+        if (commands_sent < current->write_len) {
+            command = current->write_data[commands_sent];
+        } else {
+            // Every read command fills an RX FIFO entry, wait for the
+            // handler to drain them rather than overflow it
+            uint32_t unread = commands_sent - current->write_len - bytes_read;
+            if (unread >= FIFO_DEPTH)
+                break;
+            command = I2C_IC_DATA_CMD_CMD_BITS;
+            // Turn the bus around after the write
+            if (commands_sent == current->write_len && current->write_len)
+                command |= I2C_IC_DATA_CMD_RESTART_BITS;
+        }
+        if (commands_sent == total - 1)
+            command |= I2C_IC_DATA_CMD_STOP_BITS;
+        hw->data_cmd = command;
+        commands_sent++;
+    }
+
+    // Wake on TX room only while that is what holds the rest back, a read
+    // waiting for RX room is woken by RX_FULL
+    if (fifo_full)
+        hw->intr_mask |= I2C_IC_INTR_MASK_M_TX_EMPTY_BITS;
+    else
+        hw->intr_mask &= ~I2C_IC_INTR_MASK_M_TX_EMPTY_BITS;
+}
+
+void I2cEngine::handle_irq() {
+    i2c_hw_t *hw = i2c_get_hw(i2c);
+    const uint32_t status = hw->intr_stat;
+    if (current == nullptr) {
+        hw->intr_mask = 0;
+        return;
+    }
+
+    while (hw->rxflr > 0) {
+        uint8_t byte = hw->data_cmd & 0xFF;
+        if (bytes_read < current->read_len)
+            current->read_data[bytes_read] = byte;
+        bytes_read++;
+    }
+
+    if (status & I2C_IC_INTR_STAT_R_TX_ABRT_BITS) {
+        // NACK or lost arbitration, the controller flushes the FIFO and
+        // sends a stop on its own
+        (void)hw->clr_tx_abrt;
+        aborted = true;
+        hw->intr_mask &= ~I2C_IC_INTR_MASK_M_TX_EMPTY_BITS;
+    }
+
+    if (status & I2C_IC_INTR_STAT_R_STOP_DET_BITS) {
+        (void)hw->clr_stop_det;
+        if (current->job != nullptr) {
+            if (aborted || bytes_read < current->read_len)
+                current->job->failed = true;
+            current->job->remaining--;
+        }
+        queue.release_read();
+        start_next();
+        return;
+    }
+
+    // TX room, or RX room for more read commands
+    if (!aborted)
+        fill_tx_fifo();
+}
@@ -0,0 +1,72 @@
+#ifndef I2C_ENGINE_HPP
+#define I2C_ENGINE_HPP
+
+#include "SpscQueue.hpp"
+#include "config.hpp"
+#include "hardware/i2c.h"
+#include <cstddef>
+#include <cstdint>
+
+// Short writes are copied into the transaction, longer ones are sent from
+// the caller's buffer
+#define I2C_INLINE_BYTES 8
+
+// Completion of a group of transactions. Set remaining to the number
+// submitted, each one counts it down from the interrupt handler.
+struct I2cJob {
+    volatile uint8_t remaining = 0;
+    volatile bool failed = false; // a transaction was not acknowledged
+
+    bool done() const { return remaining == 0; }
+};
+
+// Interrupt-driven transaction queue for one I2C controller.
+//
+// submit() only queues, the I2C interrupt streams every transaction
+// through the controller FIFOs in order: the write bytes, then the read
+// commands after a repeated start, then a stop. Nothing on the caller's
+// side ever waits for the bus.
+class I2cEngine {
+  public:
+    // Take over the controller, after i2c_init() and any blocking setup
+    void init(i2c_inst_t *i2c);
+
+    // Queue a write of write_len bytes followed by a read of read_len
+    // bytes into read_data. Writes longer than I2C_INLINE_BYTES are sent
+    // from write_data, which must then stay untouched until job is done.
+    // Returns false, and queues nothing, when the queue is full.
+    bool submit(uint8_t address, const uint8_t *write_data, size_t write_len,
+                uint8_t *read_data, size_t read_len, I2cJob *job);
+    size_t free_slots() const { return queue.capacity() - queue.size(); }
+
+  private:
+    struct Transaction {
+        uint8_t address;
+        uint8_t inline_data[I2C_INLINE_BYTES];
+        const uint8_t *write_data;
+        uint16_t write_len;
+        uint16_t read_len;
+        uint8_t *read_data;
+        I2cJob *job;
+    };
+
+    static void irq0();
+    static void irq1();
+    void handle_irq();
+    // Start the oldest queued transaction, if the controller is free.
+    // Interrupts must be off or this must be the handler.
+    void start_next();
+    // Push commands into the TX FIFO until it is full or all are in
+    void fill_tx_fifo();
+
+    i2c_inst_t *i2c = nullptr;
+    SpscQueue<Transaction, I2C_QUEUE_SLOTS> queue;
+
+    // Progress of the transaction at the head of the queue
+    Transaction *current = nullptr;
+    uint16_t commands_sent = 0;
+    uint16_t bytes_read = 0;
+    bool aborted = false;
+};
+
+#endif // !I2C_ENGINE_HPP
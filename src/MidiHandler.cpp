@@ -21,12 +21,12 @@ const uint8_t MidiHandler::note_sequence[64] = {
 MidiHandler::MidiHandler(Synth& synth) : synth(synth) {}
 
 // Process incoming MIDI
-void MidiHandler::midi_task() {
+void MidiHandler::midi_task(uint32_t sample) {
     uint8_t packet[4];
 
     while (tud_midi_available()) {
         tud_midi_packet_read(packet);
-        synth.process_midi_packet(packet);
+        synth.queue_midi_packet(packet, sample);
     }
 
     // static uint32_t start_ms = 0;
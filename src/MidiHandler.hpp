@@ -57,7 +57,8 @@ class MidiHandler {
   public:
     MidiHandler(Synth &synth);
 
-    void midi_task();
+    // Queue the packets read now to take effect on sample of the synth
+    void midi_task(uint32_t sample);
 
   private:
     Synth &synth;
@@ -3,28 +3,29 @@
 #include "config.hpp"
 
 Oscillator::Oscillator()
-    : freq(440.f), wavetable_(&sine_wave_table), step(0), pos(0) {
+    : wavetable_(&sine_wave_table), pos(0), step(0) {
 } // Default constructor
 
-Oscillator::Oscillator(WaveType wave_type, float freq) : freq(freq) {
+Oscillator::Oscillator(WaveType wave_type, float freq) {
     set_wavetable(wave_type);
     set_freq(freq);
 }
 
 void Oscillator::set_wavetable(WaveType wave_type) {
     // Choose the wavetable based on wave type
+    mipmap_ = nullptr;
     switch (wave_type) {
     case Sine:
         wavetable_ = &sine_wave_table;
         break;
     case Square:
-        wavetable_ = &square_wave_table;
+        mipmap_ = &square_mipmap;
         break;
     case Triangle:
-        wavetable_ = &triangle_wave_table;
+        mipmap_ = &triangle_mipmap;
         break;
     case Sawtooth:
-        wavetable_ = &sawtooth_wave_table;
+        mipmap_ = &sawtooth_mipmap;
         break;
     case Sinc:
         wavetable_ = &sinc_table;
@@ -34,32 +35,118 @@ void Oscillator::set_wavetable(WaveType wave_type) {
         break;
     }
     wave_type_ = wave_type;
+    select_mipmap_level();
+}
+
+void Oscillator::select_mipmap_level() {
+    if (mipmap_ != nullptr) {
+        wavetable_ = &(*mipmap_)[wave_mipmap_level(step)];
+    }
 }
 
 WaveType Oscillator::get_wave_type(){
     return wave_type_;
 }
 
-void Oscillator::out() {
-    const uint32_t pos_mask = (WAVE_TABLE_LEN << 16) - 1;
+const char *interp_mode_to_string(InterpMode mode) {
+    switch (mode) {
+    case INTERP_TRUNCATE:
+        return "Trunc";
+    case INTERP_LINEAR:
+        return "Linear";
+    case INTERP_HERMITE:
+        return "Hermite";
+    default:
+        return "Unknown";
+    }
+}
+
+void Oscillator::render(int32_t *mix, size_t size, q8_24_t gain,
+                        q8_24_t gain_inc) {
+    // Pick the kernel once per run, not per sample
+    switch (interp_mode) {
+    case INTERP_LINEAR:
+        render_kernel<INTERP_LINEAR>(mix, size, gain, gain_inc);
+        break;
+    case INTERP_HERMITE:
+        render_kernel<INTERP_HERMITE>(mix, size, gain, gain_inc);
+        break;
+    default:
+        render_kernel<INTERP_TRUNCATE>(mix, size, gain, gain_inc);
+        break;
+    }
+}
 
-    for (int i = 0; i < SAMPLES_PER_BUFFER; i++) {
+template <InterpMode mode>
+void Oscillator::render_kernel(int32_t *mix, size_t size, q8_24_t gain,
+                               q8_24_t gain_inc) {
+    const uint32_t pos_mask = (WAVE_TABLE_LEN << 16) - 1;
+    const uint32_t index_mask = WAVE_TABLE_LEN - 1;
+    const int16_t *table = wavetable_->data();
+    uint32_t phase = pos;
 
+    for (size_t i = 0; i < size; i++) {
         // Extract the integer part of the position (top 16 bits)
-        uint32_t pos_int = pos >> 16;
-        output[i] = (*wavetable_)[pos_int];
+        uint32_t index = phase >> 16;
+        int32_t value;
+
+        if constexpr (mode == INTERP_TRUNCATE) {
+            value = table[index];
+        } else if constexpr (mode == INTERP_LINEAR) {
+            // Q15 fraction, (b - a) * frac still fits in 32 bits
+            int32_t frac = (phase >> 1) & 0x7FFF;
+            int32_t a = table[index];
+            int32_t b = table[(index + 1) & index_mask];
+            value = a + (((b - a) * frac + (1 << 14)) >> 15);
+        } else {
+            int32_t x0 = table[(index - 1) & index_mask];
+            int32_t x1 = table[index];
+            int32_t x2 = table[(index + 1) & index_mask];
+            int32_t x3 = table[(index + 2) & index_mask];
+
+            // Coefficients at twice their size to avoid the halves. A Q11
+            // fraction keeps every Horner step inside 32 bits and is still
+            // far below one LSB of phase error.
+            int32_t frac = (phase >> 5) & 0x7FF;
+            int32_t c1 = x2 - x0;
+            int32_t c2 = 2 * x0 - 5 * x1 + 4 * x2 - x3;
+            int32_t c3 = (x3 - x0) + 3 * (x1 - x2);
+
+            value = (((c3 * frac) >> 11) + c2) * frac >> 11;
+            value = x1 + (((value + c1) * frac + (1 << 11)) >> 12);
+
+            // The cubic may overshoot the table peaks slightly
+            if (value > INT16_MAX)
+                value = INT16_MAX;
+            if (value < INT16_MIN)
+                value = INT16_MIN;
+        }
+
+        int16_t sample =
+            static_cast<int16_t>((value * (gain >> 10)) >> 14);
+        // divide by 8
+        mix[i] += sample >> 3;
+        gain += gain_inc;
 
         // Increment position and wrap around using bitwise operations
-        pos = (pos + step) & pos_mask;
+        phase = (phase + step) & pos_mask;
     }
+    pos = phase;
+}
+
+void Oscillator::set_freq(float new_freq) {
+    set_phase_increment(
+        static_cast<uint32_t>(new_freq / 44100.f * 4294967296.0f));
 }
 
-std::array<int16_t, SAMPLES_PER_BUFFER> &Oscillator::get_output() {
-    return output;
+void Oscillator::set_phase_increment(uint32_t increment) {
+    phase_increment = increment;
+    // 2^32 per cycle down to 16.16 table samples (WAVE_TABLE_LEN is 2^9)
+    step = increment >> (7 + rate_shift);
+    select_mipmap_level();
 }
 
-void Oscillator::set_freq(float new_freq) {
-    // Convert to fixed-point (16.16 format)
-    step = static_cast<uint32_t>((WAVE_TABLE_LEN * new_freq / 44100.0f) *
-                                 65536.0f);
+void Oscillator::set_oversampling(bool enable) {
+    rate_shift = enable ? 1 : 0;
+    set_phase_increment(phase_increment);
 }
@@ -5,27 +5,59 @@
 #include "config.hpp"
 #include "fixed_point.h"
 #include <array>
+#include <cstddef>
 #include <cstdint>
 
+// How the oscillator reads between table entries, cheapest first
+enum InterpMode {
+    INTERP_TRUNCATE, // nearest lower entry
+    INTERP_LINEAR,   // 2-point linear
+    INTERP_HERMITE,  // 4-point, 3rd-order Hermite (Catmull-Rom)
+    NUM_INTERP_MODES
+};
+
+const char *interp_mode_to_string(InterpMode mode);
+
 class Oscillator {
   public:
     Oscillator();
     Oscillator(WaveType wave_type, float freq);
 
-    void out();
-    std::array<int16_t, SAMPLES_PER_BUFFER> &get_output();
+    // Fused voice kernel: advance the phase, look up the table, apply the
+    // envelope gain and accumulate into the mix bus in one pass. The gain
+    // starts at gain (Q8.24) and moves by gain_inc after every sample. The
+    // bus is 32 bits wide so no number of voices wraps it, Synth clips the
+    // finished mix once.
+    void render(int32_t *mix, size_t size, q8_24_t gain, q8_24_t gain_inc);
     void set_freq(float new_freq);
+    // Pitch as a phase increment per 44.1 kHz sample, 2^32 per cycle (see
+    // pitch_to_step())
+    void set_phase_increment(uint32_t increment);
+    // Run at twice the output rate, for the oversampled voice path. The
+    // mipmap level follows, so the table keeps the harmonics up to the
+    // new Nyquist.
+    void set_oversampling(bool enable);
     void set_wavetable(WaveType wave_table);
     WaveType get_wave_type();
-
+    void set_interp_mode(InterpMode mode) { interp_mode = mode; }
+    InterpMode get_interp_mode() const { return interp_mode; }
 
   private:
+    // Pick the mipmap level that is band-limited for the current step
+    void select_mipmap_level();
+
+    template <InterpMode mode>
+    void render_kernel(int32_t *mix, size_t size, q8_24_t gain,
+                       q8_24_t gain_inc);
+
     WaveType wave_type_;
     const std::array<int16_t, WAVE_TABLE_LEN> *wavetable_;
-    std::array<int16_t, SAMPLES_PER_BUFFER> output = {};
+    const WaveMipmap *mipmap_ = nullptr; // nullptr for single-table waves
     q16_16_t pos = 0;           // Fixed-point position (16.16 format)
-    q16_16_t step;          // Fixed-point step size (16.16 format)
-    float freq;
+    q16_16_t step = 0;      // Fixed-point step size (16.16 format)
+    uint32_t phase_increment = 0; // at 44.1 kHz, 2^32 per cycle
+    int rate_shift = 0;           // 1 when oversampling
+    InterpMode interp_mode = INTERP_TRUNCATE;
 };
 
 #endif // !OSCILLATOR_HPP
@@ -0,0 +1,108 @@
+#include "Profiler.hpp"
+#include <cstdio>
+
+const char *profile_stage_to_string(ProfileStage stage) {
+    switch (stage) {
+    case PROF_OSCILLATORS:
+        return "Oscillators";
+    case PROF_ENVELOPES:
+        return "Envelopes";
+    case PROF_MIX:
+        return "Mix";
+    case PROF_FILTER_FIR:
+        return "FIR";
+    case PROF_FILTER_CHEB:
+        return "Cheb";
+    case PROF_FILTER_SVF:
+        return "SVF";
+    case PROF_VOICE_FILTER:
+        return "Voice filters";
+    case PROF_DECIMATOR:
+        return "Decimator";
+    case PROF_CONVERT:
+        return "Convert";
+    case PROF_RENDER:
+        return "Render";
+    default:
+        return "Unknown";
+    }
+}
+
+#if SYNTH_PROFILE
+
+#include "hardware/clocks.h"
+#include "hardware/structs/systick.h"
+#include "pico/platform.h"
+
+// SysTick is a 24-bit down counter
+#define SYSTICK_MASK 0xFFFFFF
+
+struct StageStats {
+    uint32_t pending; // cycles in the buffer not committed yet
+    bool touched;     // stage ran since the last commit
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    uint32_t buffers;
+};
+
+static StageStats stats[NUM_PROF_STAGES];
+
+void profile_init() {
+    systick_hw->rvr = SYSTICK_MASK;
+    systick_hw->cvr = 0;
+    // Enabled, counting the processor clock, no interrupt
+    systick_hw->csr = 0x5;
+    profile_reset();
+}
+
+uint32_t __not_in_flash_func(profile_now)() { return systick_hw->cvr; }
+
+void __not_in_flash_func(profile_add)(ProfileStage stage, uint32_t start) {
+    if (get_core_num() != 0)
+        return;
+    // Counting down, so start is the larger value
+    stats[stage].pending += (start - systick_hw->cvr) & SYSTICK_MASK;
+    stats[stage].touched = true;
+}
+
+void __not_in_flash_func(profile_commit)(ProfileStage stage) {
+    StageStats &s = stats[stage];
+    if (!s.touched)
+        return;
+    if (s.pending < s.min)
+        s.min = s.pending;
+    if (s.pending > s.max)
+        s.max = s.pending;
+    s.total += s.pending;
+    s.buffers++;
+    s.pending = 0;
+    s.touched = false;
+}
+
+void profile_print(size_t block_size) {
+    uint32_t deadline = clock_get_hz(clk_sys) / 44100 * block_size;
+    printf("Stage        min     avg     max  (cycles/buffer, deadline %lu)\n",
+           deadline);
+    for (int i = 0; i < NUM_PROF_STAGES; i++) {
+        const StageStats &s = stats[i];
+        if (s.buffers == 0)
+            continue;
+        uint32_t avg = s.total / s.buffers;
+        // Per mille of the deadline, printed as a percentage
+        uint32_t avg_pm = (uint64_t)avg * 1000 / deadline;
+        uint32_t max_pm = (uint64_t)s.max * 1000 / deadline;
+        printf("%-11s %7lu %7lu %7lu  avg %lu.%lu%% max %lu.%lu%%\n",
+               profile_stage_to_string(static_cast<ProfileStage>(i)), s.min,
+               avg, s.max, avg_pm / 10, avg_pm % 10, max_pm / 10,
+               max_pm % 10);
+    }
+}
+
+void profile_reset() {
+    for (auto &s : stats) {
+        s = {0, false, UINT32_MAX, 0, 0, 0};
+    }
+}
+
+#endif // SYNTH_PROFILE
@@ -0,0 +1,60 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include "config.hpp"
+#include <cstddef>
+#include <cstdint>
+
+// Per-stage cycle profiler for the render path.
+//
+// Stages are timed with the core's SysTick counting CPU cycles. A stage may
+// be entered several times per buffer (once per voice, once per envelope
+// segment), the cycles add up until profile_commit() closes the buffer for
+// that stage and folds the sum into its min/avg/max.
+//
+// With SYNTH_PROFILE 0 (release builds) every probe expands to nothing.
+
+enum ProfileStage {
+    PROF_OSCILLATORS,  // fused oscillator kernels
+    PROF_ENVELOPES,    // envelope segment bookkeeping
+    PROF_MIX,          // clearing the mix bus, summing the core 1 half
+    PROF_FILTER_FIR,   // FilterFIR::out
+    PROF_FILTER_CHEB,  // FilterCheb::out
+    PROF_FILTER_SVF,   // FilterSVF::out
+    PROF_VOICE_FILTER, // per-voice filters, their envelopes and the sum
+    PROF_DECIMATOR,    // half-band decimation of oversampled voices
+    PROF_CONVERT,      // int16 to S32 stereo in the I2S buffer
+    PROF_RENDER,       // the whole of Synth::out
+    NUM_PROF_STAGES
+};
+
+const char *profile_stage_to_string(ProfileStage stage);
+
+#if SYNTH_PROFILE
+
+// Start the SysTick of the calling core as a free running cycle counter
+void profile_init();
+uint32_t profile_now();
+// Add the cycles since start to the current buffer of stage
+void profile_add(ProfileStage stage, uint32_t start);
+// Close the current buffer of stage, if it ran at all
+void profile_commit(ProfileStage stage);
+// Print min/avg/max per buffer and the share of a block_size deadline
+void profile_print(size_t block_size);
+void profile_reset();
+
+// Only core 0 is timed, with dual-core rendering the voice stages cover
+// the half of the voices rendered there
+#define PROFILE_START(var) uint32_t var = profile_now()
+#define PROFILE_STOP(stage, var) profile_add(stage, var)
+#define PROFILE_COMMIT(stage) profile_commit(stage)
+
+#else
+
+#define PROFILE_START(var)
+#define PROFILE_STOP(stage, var)
+#define PROFILE_COMMIT(stage)
+
+#endif // SYNTH_PROFILE
+
+#endif // !PROFILER_HPP
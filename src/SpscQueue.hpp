@@ -0,0 +1,64 @@
+#ifndef SPSC_QUEUE_HPP
+#define SPSC_QUEUE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Lock-free single-producer/single-consumer ring of N slots.
+//
+// The producer fills a slot in place (acquire_write/commit_write) and the
+// consumer reads it in place (acquire_read/release_read), so nothing is
+// copied between them. head and tail are free-running counters and each side
+// only ever stores its own one. The release/acquire pairs publish the slot
+// contents, which on the RP2040 emits a DMB, so producer and consumer may sit
+// on different cores or in an interrupt handler.
+template <typename T, size_t N> class SpscQueue {
+    static_assert(N >= 2 && (N & (N - 1)) == 0,
+                  "SpscQueue size must be a power of two");
+
+  public:
+    // Producer side: a free slot to fill, or nullptr when the ring is full
+    T *acquire_write() {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == N)
+            return nullptr;
+        return &slots[h & (N - 1)];
+    }
+
+    // Producer side: hand the slot returned by acquire_write() to the consumer
+    void commit_write() {
+        head.store(head.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_release);
+    }
+
+    // Consumer side: the oldest ready slot, or nullptr when the ring is empty
+    T *acquire_read() {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (head.load(std::memory_order_acquire) == t)
+            return nullptr;
+        return &slots[t & (N - 1)];
+    }
+
+    // Consumer side: give the slot returned by acquire_read() back
+    void release_read() {
+        tail.store(tail.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_release);
+    }
+
+    // Number of slots ready for the consumer (a snapshot, either side)
+    size_t size() const {
+        return head.load(std::memory_order_acquire) -
+               tail.load(std::memory_order_acquire);
+    }
+
+    static constexpr size_t capacity() { return N; }
+
+  private:
+    std::array<T, N> slots = {};
+    std::atomic<uint32_t> head{0}; // written by the producer only
+    std::atomic<uint32_t> tail{0}; // written by the consumer only
+};
+
+#endif // !SPSC_QUEUE_HPP
@@ -1,44 +1,144 @@
 #include "Synth.hpp"
 #include "Oscillator.hpp"
+#include "Profiler.hpp"
 #include "Wavetable.hpp"
 #include "config.hpp"
+#include "pico/multicore.h"
+#include "pico/platform.h"
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
 #include <cstdio>
 
+// Synth served by core 1, set before it is launched
+static Synth *core1_synth = nullptr;
+
+// Narrow a 32-bit bus to samples, clipping what does not fit
+static void clip_to_int16(const int32_t *bus, int16_t *samples, size_t size) {
+    for (size_t k = 0; k < size; k++) {
+        int32_t v = bus[k];
+        if (v > INT16_MAX)
+            v = INT16_MAX;
+        if (v < INT16_MIN)
+            v = INT16_MIN;
+        samples[k] = v;
+    }
+}
+
 Synth::Synth() {
     // init the oscillators and envelopes
     for (int i = 0; i < NUM_OSC; i++) {
         oscillators[i] = Oscillator(Sawtooth, 440.f);
-        envelopes[i] = ADSREnvelope(0.1f, 0.2f, 0.8f, .5f,
-                                    oscillators[i].get_output(), 0.f);
+        blep_oscillators[i] = BlepOscillator(Sawtooth, 440.f);
+        envelopes[i] = ADSREnvelope(0.1f, 0.2f, 0.8f, .5f, 0.f);
+        filter_envelopes[i] = ADSREnvelope(0.01f, 0.4f, 0.2f, .5f, 0.f);
     }
+    live.adsr = envelopes[0].get_ADSR();
+    params.edit() = live;
+    params.publish();
 }
 
-void Synth::out() {
-    output = {};
-    for (int i = 0; i < NUM_OSC; i++) {
-        oscillators[i].out();
-        envelopes[i].out();
+void Synth::out(int16_t *output, size_t size) {
+    PROFILE_START(render_start);
+    apply_params(params.read());
+
+    size_t done = 0;
+    while (done < size) {
+        size_t end = size;
+        MidiEvent *event = midi_events.acquire_read();
+        if (event != nullptr) {
+            int32_t offset = (int32_t)(event->sample - sample_clock);
+            if (offset <= (int32_t)done) {
+                // Due here, or late and sounding as early as it can
+                process_midi_packet(event->packet);
+                midi_events.release_read();
+                continue;
+            }
+            if ((size_t)offset < size)
+                end = offset;
+        }
+        render(output + done, end - done);
+        done = end;
     }
-    for (int i = 0; i < NUM_OSC; i++) {
-        std::array<int16_t, SAMPLES_PER_BUFFER> &env_out_i =
-            envelopes[i].get_output();
-        for (int k = 0; k < SAMPLES_PER_BUFFER; k++) {
-            // divide by 8
-            output[k] += env_out_i[k] >> 3;
+    sample_clock += size;
+    // Once over the whole block, so a new filter design takes effect at
+    // the block boundary and the Chebyshev glide spans the full block,
+    // however the MIDI events split it
+    filter(output, size);
+
+    PROFILE_STOP(PROF_RENDER, render_start);
+#if SYNTH_PROFILE
+    // render_buffer() in main.cpp closes the conversion stage itself
+    for (int i = 0; i < NUM_PROF_STAGES; i++) {
+        if (i != PROF_CONVERT)
+            profile_commit(static_cast<ProfileStage>(i));
+    }
+#endif
+}
+
+void Synth::render(int16_t *output, size_t size) {
+    int32_t *mix = mix_bus[0].data();
+    int32_t *wide = wide_bus[0].data();
+    // Only wake core 1 when its half has something to play
+    const bool both_cores =
+        dual_core && any_voice_active(CORE1_FIRST_VOICE, NUM_OSC);
+    if (both_cores) {
+        // Core 1 renders the upper half while core 0 does the lower one
+        multicore_fifo_push_blocking(size);
+        render_voices(0, CORE1_FIRST_VOICE, mix, wide, size);
+        multicore_fifo_pop_blocking();
+
+        // 32-bit sums never wrap and come out the same in any order, so
+        // this is bit-identical to rendering every voice on one core
+        PROFILE_START(mix_start);
+        const int32_t *core1_mix = mix_bus[1].data();
+        for (size_t k = 0; k < size; k++) {
+            mix[k] += core1_mix[k];
+        }
+        if (live.oversampling && !live.voice_filter) {
+            const int32_t *core1_wide = wide_bus[1].data();
+            for (size_t k = 0; k < 2 * size; k++) {
+                wide[k] += core1_wide[k];
+            }
         }
+        PROFILE_STOP(PROF_MIX, mix_start);
+    } else {
+        render_voices(0, NUM_OSC, mix, wide, size);
     }
+    collect_finished_voices();
 
-    // low_pass.out(output.data(), output.size());
-    // low_pass_cheb.out(output.data(), output.size());
+    if (live.oversampling && !live.voice_filter) {
+        // The shared 88.2 kHz bus of both cores is brought down once, by
+        // one decimator whose history runs on whichever cores played
+        PROFILE_START(decimate_start);
+        int16_t *window = oversample_scratch[0].data() + HALFBAND_HISTORY;
+        clip_to_int16(wide, window, 2 * size);
+        bus_decimator.decimate(window, size, mix);
+        PROFILE_STOP(PROF_DECIMATOR, decimate_start);
+    }
+
+    // One clip for the whole mix, on one core or two
+    PROFILE_START(clip_start);
+    clip_to_int16(mix, output, size);
+    PROFILE_STOP(PROF_MIX, clip_start);
+}
 
-    // Apply the selected filter
-    switch (current_filter_type) {
+void Synth::filter(int16_t *output, size_t size) {
+    if (live.filter_bypass)
+        return;
+    PROFILE_START(filter_start);
+    switch (live.filter_type) {
     case FILTER_LOW_PASS:
-        low_pass.out(output.data(), output.size());
+        low_pass.out(output, size);
+        PROFILE_STOP(PROF_FILTER_FIR, filter_start);
         break;
     case FILTER_CHEBYSHEV:
-        low_pass_cheb.out(output.data(), output.size());
+        low_pass_cheb.out(output, size);
+        PROFILE_STOP(PROF_FILTER_CHEB, filter_start);
+        break;
+    case FILTER_SVF:
+        svf.out(output, size);
+        PROFILE_STOP(PROF_FILTER_SVF, filter_start);
         break;
     default:
         // No filtering
@@ -46,7 +146,142 @@ void Synth::out() {
     }
 }
 
-std::array<int16_t, SAMPLES_PER_BUFFER> &Synth::get_output() { return output; }
+void Synth::render_voices(int first, int last, int32_t *mix, int32_t *wide,
+                          size_t size) {
+    const uint core = get_core_num();
+    // Oversampled voices render at 88.2 kHz. Without per-voice filters
+    // they share the wide bus and render() decimates it once, a filtered
+    // voice has to be brought down on its own.
+    int16_t *window = oversample_scratch[core].data() + HALFBAND_HISTORY;
+    const bool shared_bus = live.oversampling && !live.voice_filter;
+
+    PROFILE_START(clear_start);
+    std::fill(mix, mix + size, 0);
+    if (shared_bus)
+        std::fill(wide, wide + 2 * size, 0);
+    PROFILE_STOP(PROF_MIX, clear_start);
+    for (int i = first; i < last; i++) {
+        // Idle voices cost nothing
+        if (!envelopes[i].is_active())
+            continue;
+
+        if (shared_bus) {
+            render_voice(i, wide, size, 1);
+            continue;
+        }
+        if (!live.voice_filter) {
+            render_voice(i, mix, size, 0);
+            continue;
+        }
+
+        // With per-voice filters a voice renders on its own first
+        int32_t *voice = voice_bus[core].data();
+        std::fill(voice, voice + size, 0);
+        if (live.oversampling) {
+            // Nothing shares the wide bus with per-voice filters
+            std::fill(wide, wide + 2 * size, 0);
+            render_voice(i, wide, size, 1);
+            PROFILE_START(decimate_start);
+            clip_to_int16(wide, window, 2 * size);
+            voice_decimators[i].decimate(window, size, voice);
+            PROFILE_STOP(PROF_DECIMATOR, decimate_start);
+        } else {
+            render_voice(i, voice, size, 0);
+        }
+
+        PROFILE_START(voice_filter_start);
+        int16_t *samples = voice_scratch[core].data();
+        clip_to_int16(voice, samples, size);
+        filter_voice(i, samples, size);
+        // A resonating voice can be far louder than its oscillator, the
+        // 32-bit mix takes it whole
+        for (size_t k = 0; k < size; k++) {
+            mix[k] += samples[k];
+        }
+        PROFILE_STOP(PROF_VOICE_FILTER, voice_filter_start);
+    }
+}
+
+void Synth::render_voice(int voice, int32_t *out, size_t size,
+                         int rate_shift) {
+    // One kernel call per linear envelope run, so stage changes land on
+    // the exact sample
+    size_t done = 0;
+    while (done < size) {
+        PROFILE_START(env_start);
+        EnvelopeSegment seg = envelopes[voice].next_segment(size - done);
+        PROFILE_STOP(PROF_ENVELOPES, env_start);
+        PROFILE_START(osc_start);
+        int32_t *dst = out + (done << rate_shift);
+        size_t count = seg.count << rate_shift;
+        q8_24_t inc = seg.inc >> rate_shift;
+        if (seg.level == 0 && seg.inc == 0) {
+            // Silent run: a finished release or a note that has not
+            // started. Stop here, the rest of the block is silent too.
+            if (!envelopes[voice].is_active())
+                break;
+        } else if (live.osc_engine == ENGINE_POLYBLEP) {
+            blep_oscillators[voice].render(dst, count, seg.level, inc);
+        } else {
+            oscillators[voice].render(dst, count, seg.level, inc);
+        }
+        PROFILE_STOP(PROF_OSCILLATORS, osc_start);
+        done += seg.count;
+    }
+}
+
+void Synth::filter_voice(int voice, int16_t *samples, size_t size) {
+    FilterSVF &filter = voice_filters[voice];
+    ADSREnvelope &env = filter_envelopes[voice];
+    filter.set_damping(live.voice_filter_damping);
+    for (size_t done = 0; done < size;) {
+        size_t count = size - done < VOICE_FILTER_CONTROL_SAMPLES
+                           ? size - done
+                           : VOICE_FILTER_CONTROL_SAMPLES;
+
+        // Cutoff from the level at the start of the run, a Q24 level times
+        // Q8 semitones gives Q8 semitones again
+        int32_t sweep =
+            ((env.get_level() >> 9) * live.voice_filter_depth) >> 15;
+        filter.set_cutoff_note(live.voice_filter_base + sweep);
+        for (size_t left = count; left > 0;) {
+            left -= env.next_segment(left).count;
+        }
+
+        filter.out(samples + done, count);
+        done += count;
+    }
+}
+
+bool Synth::any_voice_active(int first, int last) const {
+    for (int i = first; i < last; i++) {
+        if (envelopes[i].is_active())
+            return true;
+    }
+    return false;
+}
+
+void Synth::core1_entry() {
+    while (true) {
+        // Each word from core 0 asks for a partial mix of that many samples,
+        // the echo means done
+        uint32_t size = multicore_fifo_pop_blocking();
+        core1_synth->render_voices(CORE1_FIRST_VOICE, NUM_OSC,
+                                   core1_synth->mix_bus[1].data(),
+                                   core1_synth->wide_bus[1].data(), size);
+        multicore_fifo_push_blocking(size);
+    }
+}
+
+void Synth::set_dual_core(bool enable) {
+    if (enable && !core1_launched) {
+        core1_synth = this;
+        multicore_launch_core1(core1_entry);
+        core1_launched = true;
+    }
+    dual_core = enable;
+    printf("Dual-core rendering: %s\n", dual_core ? "on" : "off");
+}
 
 void Synth::process_midi_packet(uint8_t packet[4]) {
     uint8_t msg_type = packet[1] & 0xF0;
@@ -78,66 +313,146 @@ void Synth::process_midi_packet(uint8_t packet[4]) {
         note_off(note, velocity);
         break;
 
-    case 0xB0: // Control Change
-        // printf("Control Change: channel=%d, controller=%d, value = % d\n
-        // ",channel channel, note, velocity); Handle control change message
-        if (note == 0x02) {
-            // float fc = 200.f + (float)velocity / 127.f * 9000.f;
-            // printf("fc = %f\n", fc);
-            // low_pass.set_cutoff_freq(fc);
-            // low_pass_cheb.set_cutoff_freq(fc, 0.5f);
-        }
-        // For example: set_controller(note, velocity);
-        //
+    case 0xB0: // Control Change, controller and value
+        cc_router.control_change(note, velocity);
+        break;
+
+    case 0xE0: // Pitch Bend, 7 low bits then 7 high bits
+        set_pitch_bend(packet[2] | packet[3] << 7);
         break;
 
         // Add other MIDI message types as needed
     }
 }
 
+void Synth::queue_midi_packet(const uint8_t packet[4], uint32_t sample) {
+    // Controllers glide once per block anyway, the router takes them here
+    // on the UI side
+    if ((packet[1] & 0xF0) == 0xB0) {
+        cc_router.control_change(packet[2], packet[3]);
+        return;
+    }
+    MidiEvent *event = midi_events.acquire_write();
+    if (event == nullptr) {
+        // Better early than lost, a dropped note off would hang
+        uint8_t now[4] = {packet[0], packet[1], packet[2], packet[3]};
+        process_midi_packet(now);
+        return;
+    }
+    event->sample = sample;
+    std::copy(packet, packet + 4, event->packet);
+    midi_events.commit_write();
+}
+
 void Synth::note_on(uint8_t note, uint8_t velocity) {
-    // Check if note is playing
-    int osc_index = -1;
-    for (int i = 0; i < NUM_OSC; i++) {
-        if (osc_midi_note[i] == note && osc_playing[i]) {
-            // printf("Note already playing: note=%d, velocity=%d\n", note,
-            // velocity);
-            osc_index = i;
-            break;
-        }
+    (void)velocity; // every note plays at full level for now
+    // A held note pressed again keeps its voice and envelope
+    if (note > 127 || notes_playing_bitset.test(note))
+        return;
+
+    // The quietest policy needs the envelope levels, nothing else does
+    q8_24_t levels[NUM_OSC];
+    const q8_24_t *levels_ptr = nullptr;
+    if (voice_allocator.get_policy() == VoiceAllocator::STEAL_QUIETEST &&
+        voice_allocator.active_count() >= voice_allocator.get_voice_limit()) {
+        fill_voice_levels(levels);
+        levels_ptr = levels;
     }
 
-    // Check if there are any free oscilators
-    if (osc_index == -1) {
-        for (int i = 0; i < NUM_OSC; i++) {
-            if (!osc_playing[i]) {
-                osc_playing[i] = true;
-                osc_midi_note[i] = note;
-                notes_playing_bitset.set(note);
-
-                float freq = midi_to_freq(note);
-                oscillators[i].set_freq(freq);
-                envelopes[i].set_trigger(5.f);
-                envelopes[i].set_idle();
-                // printf("New Note: note=%d, velocity=%d\n", note, velocity);
-                break;
-            }
-        }
+    VoiceAllocator::Allocation alloc = voice_allocator.note_on(note, levels_ptr);
+    if (alloc.voice < 0)
+        return;
+    if (alloc.stolen_note >= 0)
+        notes_playing_bitset.reset(alloc.stolen_note);
+
+    int i = alloc.voice;
+    notes_playing_bitset.set(note);
+    voice_pitch[i] = note * 100;
+    retune_voice(i);
+    envelopes[i].set_trigger(5.f);
+    envelopes[i].set_idle();
+    filter_envelopes[i].set_trigger(5.f);
+    filter_envelopes[i].set_idle();
+    // A stolen voice must not ring into the new note
+    voice_filters[i].reset();
+}
+
+void Synth::set_pitch_bend(uint16_t value) {
+    pitch_bend = ((int32_t)value - 8192) * pitch_bend_range / 8192;
+    for (int i = 0; i < NUM_OSC; i++) {
+        if (envelopes[i].is_active())
+            retune_voice(i);
     }
 }
 
+void Synth::set_pitch_bend_range(int semitones) {
+    pitch_bend_range = semitones * 100;
+}
+
+void Synth::set_voice_detune(int voice, int32_t cents) {
+    params.edit().voice_detune[voice] = cents;
+    publish_params();
+}
+
+void Synth::retune_voice(int voice) {
+    uint32_t increment = pitch_to_step(voice_pitch[voice] + pitch_bend +
+                                       live.voice_detune[voice]);
+    oscillators[voice].set_phase_increment(increment);
+    blep_oscillators[voice].set_phase_increment(increment);
+}
+
 void Synth::note_off(uint8_t note, uint8_t velocity) {
-    // Check if note is playing
-    // printf("I am in note off");
+    (void)velocity; // release velocity is not used
+    int i = voice_allocator.note_off(note);
+    if (i < 0)
+        return;
+    // The voice stays allocated until its release tail has run out
+    envelopes[i].set_trigger(0.f);
+    filter_envelopes[i].set_trigger(0.f);
+    notes_playing_bitset.reset(note);
+}
+
+void Synth::silence_voice(int voice, int note) {
+    if (note >= 0)
+        notes_playing_bitset.reset(note);
+    envelopes[voice].set_trigger(0.f);
+    envelopes[voice].set_idle();
+    filter_envelopes[voice].set_trigger(0.f);
+    filter_envelopes[voice].set_idle();
+}
+
+void Synth::collect_finished_voices() {
+    int i = voice_allocator.first_released();
+    while (i >= 0) {
+        int next = voice_allocator.next_released(i);
+        if (!envelopes[i].is_active())
+            voice_allocator.voice_finished(i);
+        i = next;
+    }
+}
+
+void Synth::fill_voice_levels(q8_24_t *levels) const {
     for (int i = 0; i < NUM_OSC; i++) {
-        if (osc_midi_note[i] == note && osc_playing[i]) {
-            envelopes[i].set_trigger(0.f);
-            osc_playing[i] = false;
-            notes_playing_bitset.reset(note);
-            // printf("Note Off on Synth: note=%d, velocity=%d\n", note,
-            // velocity);
+        levels[i] = envelopes[i].get_level();
+    }
+}
+
+void Synth::set_steal_policy(VoiceAllocator::StealPolicy policy) {
+    params.edit().steal_policy = policy;
+    publish_params();
+    printf("Voice stealing: %s\n", steal_policy_to_string(policy));
+}
+
+void Synth::apply_voice_limit(int limit) {
+    voice_allocator.set_voice_limit(limit);
+    q8_24_t levels[NUM_OSC];
+    while (voice_allocator.active_count() > voice_allocator.get_voice_limit()) {
+        fill_voice_levels(levels);
+        int note = -1;
+        int voice = voice_allocator.steal(levels, &note);
+        if (voice < 0)
             break;
-        }
+        silence_voice(voice, note);
     }
 }
 
@@ -169,8 +484,7 @@ const char *Synth::get_notes_playing_names() {
 }
 
 void Synth::cycle_wave_type(int delta) {
-    WaveType wave_type = oscillators[0].get_wave_type();
-    int new_index = static_cast<int>(wave_type) + delta;
+    int new_index = static_cast<int>(get_wave_type()) + delta;
 
     // Wrap around the enum range
     const int max_wave = static_cast<int>(WaveType::Sinc);
@@ -179,40 +493,230 @@ void Synth::cycle_wave_type(int delta) {
     if (new_index < 0)
         new_index = max_wave;
 
-    wave_type = static_cast<WaveType>(new_index);
-
-    for (auto &osc : oscillators) {
-        osc.set_wavetable(wave_type);
-    }
+    set_wave_type(static_cast<WaveType>(new_index));
+}
 
+void Synth::set_wave_type(WaveType wave_type) {
+    params.edit().wave_type = wave_type;
+    publish_params();
     printf("Waveform set to: %d\n", wave_type);
 }
 
+void Synth::set_volume(uint32_t volume) {
+    params.edit().volume = volume > 256 ? 256 : volume;
+    publish_params();
+}
+
+void Synth::set_interp_mode(InterpMode mode) {
+    params.edit().interp_mode = mode;
+    publish_params();
+    printf("Interpolation set to: %s\n", interp_mode_to_string(mode));
+}
+
+void Synth::set_osc_engine(OscEngine engine) {
+    params.edit().osc_engine = engine;
+    publish_params();
+    printf("Oscillator engine: %s\n",
+           engine == ENGINE_POLYBLEP ? "PolyBLEP" : "Wavetable");
+}
+
+void Synth::set_pulse_width(uint16_t width_q16) {
+    params.edit().pulse_width = width_q16;
+    publish_params();
+}
+
+void Synth::set_voice_limit(int limit) {
+    params.edit().voice_limit =
+        limit < 1 ? 1 : (limit > NUM_OSC ? NUM_OSC : limit);
+    publish_params();
+}
+
+void Synth::set_filter_bypass(bool bypass) {
+    params.edit().filter_bypass = bypass;
+    publish_params();
+}
+
+void Synth::increment_ADSR(uint8_t which, int32_t delta_q24) {
+    if (which < 4)
+        set_ADSR_param(which, get_params().adsr[which] + delta_q24);
+}
+
+void Synth::set_ADSR_param(uint8_t which, q8_24_t value) {
+    if (which >= 4)
+        return;
+    value = value < 0 ? 0 : value;
+    // Sustain is a level, at most full scale
+    if (which == 2 && value > Q24_ONE)
+        value = Q24_ONE;
+    params.edit().adsr[which] = value;
+    publish_params();
+}
+
 void Synth::cycle_filter_type() {
-    current_filter_type =
-        static_cast<FilterType>((current_filter_type + 1) % NUM_FILTER_TYPES);
+    SynthParams &p = params.edit();
+    p.filter_type =
+        static_cast<FilterType>((p.filter_type + 1) % NUM_FILTER_TYPES);
+    publish_params();
 }
 
 void Synth::set_filter_cutoff(float cutoff, float q) {
-    switch (current_filter_type) {
-    case FILTER_LOW_PASS:
-        low_pass.set_cutoff_freq(cutoff);
-        break;
-    case FILTER_CHEBYSHEV:
-        low_pass_cheb.set_cutoff_freq(cutoff, q);
-        break;
-    default:
-        break;
+    SynthParams &p = params.edit();
+    if (p.filter_type == FILTER_OFF)
+        return;
+    p.cutoff[p.filter_type] = cutoff;
+    // q is the Chebyshev ripple, the SVF keeps its own resonance
+    if (p.filter_type == FILTER_CHEBYSHEV)
+        p.cheb_ripple = q;
+    publish_params();
+}
+
+float Synth::get_filter_cutoff() const {
+    const SynthParams &p = get_params();
+    return p.filter_type == FILTER_OFF ? 0.0f : p.cutoff[p.filter_type];
+}
+
+void Synth::set_filter_resonance(float q) {
+    q = q < SVF_MIN_Q ? SVF_MIN_Q : (q > SVF_MAX_Q ? SVF_MAX_Q : q);
+    params.edit().resonance = q;
+    publish_params();
+    printf("SVF resonance: Q = %.2f\n", q);
+}
+
+void Synth::set_svf_mode(SvfMode mode) {
+    params.edit().svf_mode = mode;
+    publish_params();
+    printf("SVF mode: %s\n", svf_mode_to_string(mode));
+}
+
+void Synth::set_oversampling(bool enable) {
+    params.edit().oversampling = enable;
+    publish_params();
+    printf("2x oversampling: %s\n", enable ? "on" : "off");
+}
+
+void Synth::set_voice_filter(bool enable) {
+    params.edit().voice_filter = enable;
+    publish_params();
+    printf("Per-voice filters: %s\n", enable ? "on" : "off");
+}
+
+void Synth::update_params() {
+    if (!params_dirty)
+        return;
+    // However many encoder detents or setters came in since the last
+    // block, the filters are designed once for where they ended up
+    design_filters(params.edit());
+    params.publish();
+    params_dirty = false;
+}
+
+void Synth::design_filters(const SynthParams &next) {
+    // Every filter follows its own settings, whether selected or not, so
+    // selecting one needs no design in out()
+    if (next.cutoff[FILTER_LOW_PASS] != designed.cutoff[FILTER_LOW_PASS]) {
+        // From the cached bank when the cutoff has been used lately
+        low_pass.set_cutoff_freq(next.cutoff[FILTER_LOW_PASS]);
+        low_pass.update_coefficients();
+    }
+    if (next.cutoff[FILTER_CHEBYSHEV] != designed.cutoff[FILTER_CHEBYSHEV] ||
+        next.cheb_ripple != designed.cheb_ripple) {
+        low_pass_cheb.set_cutoff_freq(next.cutoff[FILTER_CHEBYSHEV],
+                                      next.cheb_ripple);
     }
+    if (next.cutoff[FILTER_SVF] != designed.cutoff[FILTER_SVF])
+        svf.set_cutoff_freq(next.cutoff[FILTER_SVF]);
+    if (next.resonance != designed.resonance)
+        svf.set_resonance(next.resonance);
+    designed = next;
 }
 
-float Synth::get_filter_cutoff() {
-    switch (current_filter_type) {
-    case FILTER_LOW_PASS:
-        return low_pass.get_cutoff();
-    case FILTER_CHEBYSHEV:
-        return low_pass_cheb.get_cutoff();
-    default:
-        return 0.0f;
+void Synth::apply_params(const SynthParams &next) {
+    if (next.wave_type != live.wave_type) {
+        for (auto &osc : oscillators) {
+            osc.set_wavetable(next.wave_type);
+        }
+        for (auto &osc : blep_oscillators) {
+            osc.set_wavetable(next.wave_type);
+        }
     }
+    for (uint8_t i = 0; i < 4; i++) {
+        if (next.adsr[i] == live.adsr[i])
+            continue;
+        for (auto &env : envelopes) {
+            env.set_ADSR_param(i, next.adsr[i]);
+        }
+    }
+    if (next.interp_mode != live.interp_mode) {
+        for (auto &osc : oscillators) {
+            osc.set_interp_mode(next.interp_mode);
+        }
+    }
+    if (next.oversampling != live.oversampling) {
+        for (auto &osc : oscillators) {
+            osc.set_oversampling(next.oversampling);
+        }
+        for (auto &osc : blep_oscillators) {
+            osc.set_oversampling(next.oversampling);
+        }
+        if (next.oversampling)
+            reset_decimators();
+    }
+    if (next.voice_filter != live.voice_filter) {
+        // States left from the last time would ring into the playing notes
+        if (next.voice_filter) {
+            for (auto &filter : voice_filters) {
+                filter.reset();
+            }
+        }
+        // Oversampled voices move between the shared bus and their own
+        // decimators
+        reset_decimators();
+    }
+    if (next.voice_limit != live.voice_limit)
+        apply_voice_limit(next.voice_limit);
+    if (next.steal_policy != live.steal_policy)
+        voice_allocator.set_policy(next.steal_policy);
+    if (next.pulse_width != live.pulse_width) {
+        for (auto &osc : blep_oscillators) {
+            osc.set_pulse_width(next.pulse_width);
+        }
+    }
+    const bool detune_changed = next.voice_detune != live.voice_detune;
+
+    // The filter coefficients were designed by update_params(), each
+    // filter takes its newest set up in its own out()
+    if (next.svf_mode != live.svf_mode)
+        svf.set_mode(next.svf_mode);
+
+    live = next;
+    // retune_voice() reads the detune from live
+    if (detune_changed) {
+        for (int i = 0; i < NUM_OSC; i++) {
+            retune_voice(i);
+        }
+    }
+}
+
+void Synth::reset_decimators() {
+    // History left from the last time would leak into the playing notes
+    for (auto &decimator : voice_decimators) {
+        decimator.reset();
+    }
+    bus_decimator.reset();
+}
+
+void Synth::set_voice_filter_cutoff(float base_hz, float depth_semitones) {
+    SynthParams &p = params.edit();
+    p.voice_filter_base =
+        (int32_t)((69.f + 12.f * log2f(base_hz / 440.f)) * 256.f);
+    p.voice_filter_depth = (int32_t)(depth_semitones * 256.f);
+    publish_params();
+}
+
+void Synth::set_voice_filter_resonance(float q) {
+    // filter_voice() hands it to the filters, they are only ever tuned by
+    // the core rendering them
+    q = q < SVF_MIN_Q ? SVF_MIN_Q : (q > SVF_MAX_Q ? SVF_MAX_Q : q);
+    params.edit().voice_filter_damping = q24_from_float(1.f / q);
+    publish_params();
 }
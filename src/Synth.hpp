@@ -1,52 +1,271 @@
 #ifndef SYNTH_HPP
 #define SYNTH_HPP
 
+#include "BlepOscillator.hpp"
+#include "CcRouter.hpp"
 #include "Envelope.hpp"
 #include "Filter.hpp"
 #include "MidiHandler.hpp"
 #include "Oscillator.hpp"
+#include "SpscQueue.hpp"
+#include "TripleBuffer.hpp"
+#include "VoiceAllocator.hpp"
 #include "Wavetable.hpp"
 #include "config.hpp"
 #include "tusb.h"
 #include <bitset>
 #include <cstdint>
 
-#define NUM_OSC 8
+// Voices [0, CORE1_FIRST_VOICE) render on core 0, the rest on core 1 when
+// dual-core rendering is enabled
+#define CORE1_FIRST_VOICE (NUM_OSC / 2)
+
+// Per-voice filter cutoffs follow their envelope once every this many
+// samples
+#define VOICE_FILTER_CONTROL_SAMPLES 32
+
+// A MIDI packet and the sample it takes effect on, counted like
+// Synth::get_sample_clock()
+struct MidiEvent {
+    uint32_t sample;
+    uint8_t packet[4];
+};
+
+// Which oscillator renders the voices
+enum OscEngine {
+    ENGINE_WAVETABLE, // Oscillator, mipmapped tables
+    ENGINE_POLYBLEP,  // BlepOscillator, computed from the phase
+    NUM_OSC_ENGINES
+};
+
+// Everything the UI sets and the renderer reads. The setters of Synth edit
+// one copy and publish it whole, out() takes the newest at the start of a
+// block, so a parameter never changes in the middle of one.
+struct SynthParams {
+    WaveType wave_type = Sawtooth;
+    std::array<q8_24_t, 4> adsr = {}; // A, D, S, R as in increment_ADSR()
+    FilterType filter_type = FILTER_CHEBYSHEV;
+    // Hz, every filter keeps its own
+    std::array<float, NUM_FILTER_TYPES> cutoff = {0.f, 1000.f, 5000.f,
+                                                  1000.f};
+    float cheb_ripple = 1.f;
+    float resonance = 0.707f; // SVF Q
+    SvfMode svf_mode = SVF_LOW_PASS;
+    uint32_t volume = 100; // 256 is unity
+    InterpMode interp_mode = INTERP_TRUNCATE;
+    OscEngine osc_engine = ENGINE_WAVETABLE;
+    bool oversampling = false;
+    bool voice_filter = false;
+    int voice_limit = NUM_OSC;
+    bool filter_bypass = false;
+    uint16_t pulse_width = 0x8000; // Q16, PolyBLEP square
+    std::array<int32_t, NUM_OSC> voice_detune = {}; // cents
+    VoiceAllocator::StealPolicy steal_policy =
+        VoiceAllocator::STEAL_RELEASED_FIRST;
+    // Per-voice filters, as set_voice_filter_cutoff() and
+    // set_voice_filter_resonance() take them
+    int32_t voice_filter_base = 48 << 8;  // Q8 MIDI note
+    int32_t voice_filter_depth = 60 << 8; // Q8 semitones
+    q8_24_t voice_filter_damping = q24_from_float(1.f / 0.707f); // 1 / Q
+};
 
 class Synth {
   public:
     Synth();
-    void out();
-    std::array<int16_t, SAMPLES_PER_BUFFER> &get_output();
+    // Render size samples (at most SAMPLES_PER_BUFFER) straight into the
+    // caller's buffer. Queued MIDI events due in the block split it and
+    // take effect on their own sample.
+    void out(int16_t *output, size_t size);
+    // Render and mix voices [first, last) into the 32-bit mix, without
+    // the global filter. Oversampled voices without their own filter are
+    // left on wide, 2 * size samples at 88.2 kHz, for render() to
+    // decimate.
+    void render_voices(int first, int last, int32_t *mix, int32_t *wide,
+                       size_t size);
+    bool any_voice_active(int first, int last) const;
+
+    // Split the voices across both cores. The first call launches core 1.
+    void set_dual_core(bool enable);
+    bool is_dual_core() const { return dual_core; }
     void process_midi_packet(uint8_t packet[4]);
+    // Apply packet on the given sample, or at the start of the next block
+    // if that has already been rendered
+    void queue_midi_packet(const uint8_t packet[4], uint32_t sample);
+    // Samples rendered so far, the first sample of the next out()
+    uint32_t get_sample_clock() const { return sample_clock; }
+
+    // The parameters last set, ahead of the renderer by up to a block
+    const SynthParams &get_params() const { return params.edit(); }
+    // Edit several parameters and mark them for the next update_params().
+    // Every setter ends in publish_params(), so a burst of setter calls
+    // costs no more than one.
+    SynthParams &edit_params() { return params.edit(); }
+    void publish_params() { params_dirty = true; }
+    // Design the filters for the parameters marked since the last call and
+    // hand them to out() in one piece. Runs on the caller's side, once
+    // before each block.
+    void update_params();
 
     void cycle_wave_type(int delta);
+    void set_wave_type(WaveType wave_type);
+    WaveType get_wave_type() const { return get_params().wave_type; }
+    // Output gain, 256 is unity
+    void set_volume(uint32_t volume);
+    uint32_t get_volume() const { return get_params().volume; }
+    // Gain of the last block out() rendered
+    uint32_t get_render_volume() const { return live.volume; }
+    // Table read quality of every oscillator, trades CPU for noise floor
+    void set_interp_mode(InterpMode mode);
+    InterpMode get_interp_mode() const { return get_params().interp_mode; }
+    void set_osc_engine(OscEngine engine);
+    OscEngine get_osc_engine() const { return get_params().osc_engine; }
+    // Pulse width of the PolyBLEP square, in Q16
+    void set_pulse_width(uint16_t width_q16);
+    // Render the voices at 88.2 kHz and decimate them before the mix.
+    // Doubles the oscillator cost, for patches with hard waveforms.
+    void set_oversampling(bool enable);
+    bool is_oversampling() const { return get_params().oversampling; }
+
+    // Load shedding used by RenderGovernor. Lowering the limit silences
+    // the extra voices at once, released tails first.
+    void set_voice_limit(int limit);
+    int get_voice_limit() const { return get_params().voice_limit; }
+    void set_filter_bypass(bool bypass);
+    bool is_filter_bypassed() const { return get_params().filter_bypass; }
+
+    // Envelope of every voice, stages numbered as in
+    // ADSREnvelope::increment_ADSR()
+    void increment_ADSR(uint8_t which, int32_t delta_q24);
+    void set_ADSR_param(uint8_t which, q8_24_t value);
+    const std::array<q8_24_t, 4> &get_ADSR() const {
+        return get_params().adsr;
+    }
 
     void note_on(uint8_t note, uint8_t velocity);
     void note_off(uint8_t note, uint8_t velocity);
+    // 14-bit MIDI pitch bend, 8192 is centre. Retunes the sounding voices.
+    void set_pitch_bend(uint16_t value);
+    void set_pitch_bend_range(int semitones);
+    // Offset of one voice from its note, for unison spread
+    void set_voice_detune(int voice, int32_t cents);
+    // Which sounding voice a new note takes once every voice is busy
+    void set_steal_policy(VoiceAllocator::StealPolicy policy);
+    VoiceAllocator::StealPolicy get_steal_policy() const {
+        return get_params().steal_policy;
+    }
     const char *get_notes_playing_names();
     std::bitset<128> get_notes_bitmask() const { return notes_playing_bitset; }
 
     FilterFIR low_pass = FilterFIR(1000.f);
-    FilterCheb low_pass_cheb = FilterCheb(5000.f, 1.f, 44100.f);
+    FilterCheb low_pass_cheb = FilterCheb(5000.f, 1.f);
+    FilterSVF svf = FilterSVF(1000.f);
 
     std::array<Oscillator, NUM_OSC> oscillators;
+    std::array<BlepOscillator, NUM_OSC> blep_oscillators;
     std::array<ADSREnvelope, NUM_OSC> envelopes;
 
     void cycle_filter_type();
+    FilterType get_filter_type() const { return get_params().filter_type; }
 
+    // Cutoff of the selected filter, q is the Chebyshev ripple
     void set_filter_cutoff(float cutoff, float q = 0.5f);
+    float get_filter_cutoff() const;
+    // Glide the MIDI controlled parameters one step and publish everything
+    // set since the last block, once per block and outside out()
+    void update_controls() {
+        cc_router.update();
+        update_params();
+    }
+    CcRouter cc_router = CcRouter(*this);
 
-    float get_filter_cutoff();
-    FilterType current_filter_type = FILTER_CHEBYSHEV; // Default to Chebyshev
+    // Resonance and output of the state variable filter
+    void set_filter_resonance(float q);
+    float get_filter_resonance() const { return get_params().resonance; }
+    void set_svf_mode(SvfMode mode);
+    SvfMode get_svf_mode() const { return get_params().svf_mode; }
+
+    // Give every voice its own low-pass SVF. Its cutoff starts at base_hz
+    // and rises by depth semitones at full level of filter_envelopes.
+    void set_voice_filter(bool enable);
+    bool is_voice_filter_enabled() const {
+        return get_params().voice_filter;
+    }
+    void set_voice_filter_cutoff(float base_hz, float depth_semitones);
+    void set_voice_filter_resonance(float q);
+
+    std::array<FilterSVF, NUM_OSC> voice_filters;
+    std::array<ADSREnvelope, NUM_OSC> filter_envelopes;
 
   private:
-    std::array<int16_t, SAMPLES_PER_BUFFER> output = {};
+    static void core1_entry();
 
-    std::bitset<128> notes_playing_bitset;
+    // Bring the render state in line with next, called by out() only
+    void apply_params(const SynthParams &next);
+    void apply_voice_limit(int limit);
+    // Design the filters whose settings changed since the last publish
+    void design_filters(const SynthParams &next);
 
-    uint8_t osc_midi_note[NUM_OSC] = {};
-    bool osc_playing[NUM_OSC] = {};
+    TripleBuffer<SynthParams> params;
+    SynthParams live;     // what out() renders with
+    SynthParams designed; // what the filters were last designed for
+    bool params_dirty = false; // edited since the last update_params()
+
+    // Render the voices of a run of the block with no MIDI event inside it
+    void render(int16_t *output, size_t size);
+    // Run the selected filter over a whole block
+    void filter(int16_t *output, size_t size);
+
+    SpscQueue<MidiEvent, MIDI_EVENT_SLOTS> midi_events;
+    uint32_t sample_clock = 0;
+
+    // One 32-bit mix per core, core 0 adds core 1's to its own and clips
+    // the sum once
+    std::array<std::array<int32_t, SAMPLES_PER_BUFFER>, 2> mix_bus;
+    bool dual_core = false;
+    bool core1_launched = false;
+
+
+    // Render voice over size output samples into out, 2^rate_shift samples
+    // per output sample
+    void render_voice(int voice, int32_t *out, size_t size, int rate_shift);
+
+    void reset_decimators();
+
+    std::array<HalfbandDecimator, NUM_OSC> voice_decimators;
+    HalfbandDecimator bus_decimator; // the sum of both wide buses
+    // Oversampled voices render into the 88.2 kHz bus of their core, one
+    // at a time with per-voice filters
+    std::array<std::array<int32_t, 2 * SAMPLES_PER_BUFFER>, 2> wide_bus;
+    // The 88.2 kHz samples a decimator reads, after its history, one
+    // buffer per core
+    std::array<std::array<int16_t, HALFBAND_HISTORY + 2 * SAMPLES_PER_BUFFER>,
+               2>
+        oversample_scratch;
+
+    // Run the filter of voice over its own rendering, retuned at control
+    // rate
+    void filter_voice(int voice, int16_t *samples, size_t size);
+
+    // A voice renders into voice_bus and is filtered in voice_scratch, one
+    // buffer each per core
+    std::array<std::array<int32_t, SAMPLES_PER_BUFFER>, 2> voice_bus;
+    std::array<std::array<int16_t, SAMPLES_PER_BUFFER>, 2> voice_scratch;
+
+    // Point the oscillators of voice at its note, the bend and its detune
+    void retune_voice(int voice);
+
+    std::array<int32_t, NUM_OSC> voice_pitch = {}; // note, in cents
+    int32_t pitch_bend = 0;        // cents
+    int32_t pitch_bend_range = 200; // cents at full bend
+
+    // Cut a voice taken by the allocator and drop its note from the bitset
+    void silence_voice(int voice, int note);
+    // Hand voices whose release has run out back to the allocator
+    void collect_finished_voices();
+    void fill_voice_levels(q8_24_t *levels) const;
+
+    VoiceAllocator voice_allocator;
+    std::bitset<128> notes_playing_bitset;
 };
 
 #endif // !SYNTH_HPP
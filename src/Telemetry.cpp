@@ -0,0 +1,101 @@
+#include "Telemetry.hpp"
+#include "hardware/sync.h"
+#include "pico/time.h"
+#include <cstdio>
+
+static_assert((AudioTelemetry::RING_SIZE & (AudioTelemetry::RING_SIZE - 1)) ==
+                  0,
+              "RING_SIZE must be a power of two");
+
+const char *audio_event_to_string(AudioTelemetry::EventType type) {
+    switch (type) {
+    case AudioTelemetry::EVENT_UNDERRUN:
+        return "Underrun";
+    case AudioTelemetry::EVENT_LATE_RENDER:
+        return "Late render";
+    default:
+        return "Unknown";
+    }
+}
+
+void AudioTelemetry::record(EventType type, uint32_t detail) {
+    uint32_t now = time_us_32();
+    // The callback may fire in the middle of a main loop record
+    uint32_t irq_state = save_and_disable_interrupts();
+    ring[ring_head & (RING_SIZE - 1)] = {now, detail, type};
+    ring_head++;
+    counters.events[type]++;
+    if (type == EVENT_UNDERRUN && !in_underrun) {
+        in_underrun = true;
+        underrun_start_us = now;
+    }
+    restore_interrupts(irq_state);
+}
+
+void AudioTelemetry::render_done(uint32_t render_us, uint32_t deadline_us) {
+    if (render_us > deadline_us) {
+        uint32_t late_us = render_us - deadline_us;
+        record(EVENT_LATE_RENDER, late_us);
+        if (late_us > counters.max_late_us)
+            counters.max_late_us = late_us;
+    }
+
+    uint32_t irq_state = save_and_disable_interrupts();
+    if (in_underrun) {
+        uint32_t gap_us = time_us_32() - underrun_start_us;
+        if (gap_us > counters.max_underrun_us)
+            counters.max_underrun_us = gap_us;
+        in_underrun = false;
+    }
+    restore_interrupts(irq_state);
+}
+
+AudioTelemetry::Counters AudioTelemetry::get_counters() const {
+    uint32_t irq_state = save_and_disable_interrupts();
+    Counters copy = counters;
+    restore_interrupts(irq_state);
+    return copy;
+}
+
+int AudioTelemetry::get_events(Event *out, int max) const {
+    uint32_t irq_state = save_and_disable_interrupts();
+    uint32_t head = ring_head;
+    int count = 0;
+    while (count < max && count < RING_SIZE && (uint32_t)count < head) {
+        out[count] = ring[(head - 1 - count) & (RING_SIZE - 1)];
+        count++;
+    }
+    restore_interrupts(irq_state);
+    return count;
+}
+
+void AudioTelemetry::print() const {
+    // Copy first, printing with interrupts off would stall the audio
+    Counters c = get_counters();
+    Event events[RING_SIZE];
+    int count = get_events(events, RING_SIZE);
+
+    printf("Telemetry at %lu us\n", time_us_32());
+    for (int i = 0; i < NUM_EVENT_TYPES; i++) {
+        printf("  %-12s %lu\n",
+               audio_event_to_string(static_cast<EventType>(i)),
+               c.events[i]);
+    }
+    printf("  Max late %lu us, max underrun %lu us\n", c.max_late_us,
+           c.max_underrun_us);
+    for (int i = 0; i < count; i++) {
+        printf("  %10lu %s", events[i].time_us,
+               audio_event_to_string(events[i].type));
+        if (events[i].type == EVENT_LATE_RENDER)
+            printf(" +%lu us", events[i].detail);
+        printf("\n");
+    }
+}
+
+void AudioTelemetry::reset() {
+    uint32_t irq_state = save_and_disable_interrupts();
+    counters = {};
+    ring_head = 0;
+    in_underrun = false;
+    restore_interrupts(irq_state);
+}
@@ -0,0 +1,52 @@
+#ifndef TELEMETRY_HPP
+#define TELEMETRY_HPP
+
+#include <cstdint>
+
+// Records every audio glitch with a timestamp so clicks heard on the output
+// can be matched with what the firmware was doing. Safe to call from the
+// I2S DMA callback and the main loop alike.
+class AudioTelemetry {
+  public:
+    enum EventType {
+        EVENT_UNDERRUN,    // nothing queued, the DMA played silence
+        EVENT_LATE_RENDER, // a render took longer than the buffer lasts
+        NUM_EVENT_TYPES
+    };
+
+    struct Event {
+        uint32_t time_us; // time_us_32() when it happened
+        uint32_t detail;  // lateness in us for late renders, else 0
+        EventType type;
+    };
+
+    struct Counters {
+        uint32_t events[NUM_EVENT_TYPES];
+        uint32_t max_late_us;     // longest render past its deadline
+        uint32_t max_underrun_us; // longest time without rendered audio
+    };
+
+    static constexpr int RING_SIZE = 32; // last events kept
+
+    void record(EventType type, uint32_t detail = 0);
+    // Report one render, late or not. Ends an underrun in progress.
+    void render_done(uint32_t render_us, uint32_t deadline_us);
+
+    // Copy of the counters, consistent even while audio is running
+    Counters get_counters() const;
+    // Copy up to max events, newest first, and return how many were copied
+    int get_events(Event *out, int max) const;
+    void print() const;
+    void reset();
+
+  private:
+    Event ring[RING_SIZE] = {};
+    uint32_t ring_head = 0; // total events recorded, next slot is & mask
+    Counters counters = {};
+    uint32_t underrun_start_us = 0;
+    bool in_underrun = false;
+};
+
+const char *audio_event_to_string(AudioTelemetry::EventType type);
+
+#endif // !TELEMETRY_HPP
@@ -0,0 +1,65 @@
+#ifndef TRIPLE_BUFFER_HPP
+#define TRIPLE_BUFFER_HPP
+
+#include "hardware/sync.h"
+#include <array>
+#include <cstdint>
+
+// Single-writer/single-reader snapshot of a T.
+//
+// The writer edits its own copy and publishes it whole, the reader takes the
+// newest published copy and keeps it until it asks again. Three slots rotate
+// through one shared index, so the reader never sees half an update. The
+// Cortex-M0+ has no atomic exchange (std::atomic would call into libatomic),
+// so each swap of the index holds one of the SDK's striped hardware
+// spinlocks, which also masks interrupts on the core taking it. A swap is a
+// few instructions, neither side waits longer than that for the other. The
+// lock's barriers order the slot contents like the release/acquire pairs of
+// SpscQueue, the two sides may sit on different cores or in an interrupt
+// handler.
+template <typename T> class TripleBuffer {
+  public:
+    TripleBuffer() = default;
+    explicit TripleBuffer(const T &initial) { slots.fill(initial); }
+
+    // Writer side: the copy to edit, it starts out as the last one published
+    T &edit() { return slots[back]; }
+    const T &edit() const { return slots[back]; }
+
+    // Writer side: hand the edited copy to the reader
+    void publish() {
+        uint8_t published = back;
+        uint32_t irq_state = spin_lock_blocking(lock);
+        back = middle & INDEX_MASK;
+        middle = published | FRESH;
+        spin_unlock(lock, irq_state);
+        // The reader never writes a slot, copying from the one just
+        // published is safe even if it has taken it already
+        slots[back] = slots[published];
+    }
+
+    // Reader side: the newest published copy, unchanged until the next call
+    const T &read() {
+        uint32_t irq_state = spin_lock_blocking(lock);
+        if (middle & FRESH) {
+            uint8_t newest = middle & INDEX_MASK;
+            middle = front;
+            front = newest;
+        }
+        spin_unlock(lock, irq_state);
+        return slots[front];
+    }
+
+  private:
+    static constexpr uint8_t INDEX_MASK = 0x3;
+    static constexpr uint8_t FRESH = 0x4; // middle holds an unread copy
+
+    std::array<T, 3> slots = {};
+    uint8_t back = 0;   // written by the writer only
+    uint8_t middle = 1; // swapped by both sides, under lock
+    uint8_t front = 2;  // written by the reader only
+    spin_lock_t *const lock =
+        spin_lock_instance(next_striped_spin_lock_num());
+};
+
+#endif // !TRIPLE_BUFFER_HPP
@@ -0,0 +1,175 @@
+#include "VoiceAllocator.hpp"
+
+const char *steal_policy_to_string(VoiceAllocator::StealPolicy policy) {
+    switch (policy) {
+    case VoiceAllocator::STEAL_RELEASED_FIRST:
+        return "Released first";
+    case VoiceAllocator::STEAL_OLDEST:
+        return "Oldest";
+    case VoiceAllocator::STEAL_QUIETEST:
+        return "Quietest";
+    default:
+        return "Unknown";
+    }
+}
+
+VoiceAllocator::VoiceAllocator() {
+    for (int i = 0; i < NUM_LISTS; i++) {
+        heads[i] = -1;
+        tails[i] = -1;
+    }
+    for (int i = 0; i < 128; i++) {
+        note_to_voice[i] = -1;
+    }
+    for (int v = 0; v < NUM_OSC; v++) {
+        voices[v] = {-1, -1, -1, -1, FREE, -1};
+        push_back(FREE, v);
+    }
+}
+
+void VoiceAllocator::unlink(int voice) {
+    Voice &v = voices[voice];
+    if (v.prev >= 0)
+        voices[v.prev].next = v.next;
+    else
+        heads[v.list] = v.next;
+    if (v.next >= 0)
+        voices[v.next].prev = v.prev;
+    else
+        tails[v.list] = v.prev;
+    v.prev = v.next = -1;
+    counts[v.list]--;
+}
+
+void VoiceAllocator::push_back(ListId list, int voice) {
+    Voice &v = voices[voice];
+    v.list = list;
+    v.prev = tails[list];
+    v.next = -1;
+    if (tails[list] >= 0)
+        voices[tails[list]].next = voice;
+    else
+        heads[list] = voice;
+    tails[list] = voice;
+    counts[list]++;
+}
+
+void VoiceAllocator::age_unlink(int voice) {
+    Voice &v = voices[voice];
+    if (v.age_prev >= 0)
+        voices[v.age_prev].age_next = v.age_next;
+    else
+        age_head = v.age_next;
+    if (v.age_next >= 0)
+        voices[v.age_next].age_prev = v.age_prev;
+    else
+        age_tail = v.age_prev;
+    v.age_prev = v.age_next = -1;
+}
+
+void VoiceAllocator::age_push_back(int voice) {
+    Voice &v = voices[voice];
+    v.age_prev = age_tail;
+    v.age_next = -1;
+    if (age_tail >= 0)
+        voices[age_tail].age_next = voice;
+    else
+        age_head = voice;
+    age_tail = voice;
+}
+
+void VoiceAllocator::free_voice(int voice) {
+    Voice &v = voices[voice];
+    if (v.list == FREE)
+        return;
+    if (v.note >= 0 && note_to_voice[v.note] == voice)
+        note_to_voice[v.note] = -1;
+    v.note = -1;
+    unlink(voice);
+    age_unlink(voice);
+    push_back(FREE, voice);
+}
+
+int VoiceAllocator::pick_victim(const q8_24_t *levels) const {
+    switch (policy) {
+    case STEAL_OLDEST:
+        return age_head;
+
+    case STEAL_QUIETEST:
+        if (levels != nullptr) {
+            int quietest = -1;
+            for (int v = age_head; v >= 0; v = voices[v].age_next) {
+                if (quietest < 0 || levels[v] < levels[quietest])
+                    quietest = v;
+            }
+            return quietest;
+        }
+        // Without levels, an old release tail is the best guess
+        return heads[RELEASED] >= 0 ? heads[RELEASED] : heads[HELD];
+
+    default: // STEAL_RELEASED_FIRST
+        return heads[RELEASED] >= 0 ? heads[RELEASED] : heads[HELD];
+    }
+}
+
+VoiceAllocator::Allocation VoiceAllocator::note_on(uint8_t note,
+                                                   const q8_24_t *levels) {
+    Allocation result = {-1, -1, false};
+    if (note > 127)
+        return result;
+
+    int voice = note_to_voice[note];
+    if (voice >= 0) {
+        // Same note again, held or in its tail: retrigger it in place
+        result.retrigger = true;
+    } else if (heads[FREE] >= 0 && active_count() < voice_limit) {
+        voice = heads[FREE];
+    } else {
+        voice = pick_victim(levels);
+        if (voice < 0)
+            return result;
+        result.stolen_note = voices[voice].note;
+        free_voice(voice);
+    }
+
+    unlink(voice);
+    push_back(HELD, voice);
+    if (result.retrigger)
+        age_unlink(voice);
+    age_push_back(voice);
+    voices[voice].note = note;
+    note_to_voice[note] = voice;
+
+    result.voice = voice;
+    return result;
+}
+
+int VoiceAllocator::note_off(uint8_t note) {
+    if (note > 127)
+        return -1;
+    int voice = note_to_voice[note];
+    if (voice < 0 || voices[voice].list != HELD)
+        return -1;
+    // The note stays mapped so a quick repeat reuses its own tail
+    unlink(voice);
+    push_back(RELEASED, voice);
+    return voice;
+}
+
+void VoiceAllocator::voice_finished(int voice) {
+    if (voice >= 0 && voice < NUM_OSC && voices[voice].list == RELEASED)
+        free_voice(voice);
+}
+
+int VoiceAllocator::steal(const q8_24_t *levels, int *stolen_note) {
+    int voice = pick_victim(levels);
+    if (stolen_note != nullptr)
+        *stolen_note = voice >= 0 ? voices[voice].note : -1;
+    if (voice >= 0)
+        free_voice(voice);
+    return voice;
+}
+
+void VoiceAllocator::set_voice_limit(int limit) {
+    voice_limit = limit < 1 ? 1 : (limit > NUM_OSC ? NUM_OSC : limit);
+}
@@ -0,0 +1,89 @@
+#ifndef VOICE_ALLOCATOR_HPP
+#define VOICE_ALLOCATOR_HPP
+
+#include "config.hpp"
+#include "fixed_point.h"
+#include <cstdint>
+
+// Maps MIDI notes to voices in constant time.
+//
+// Every voice is on exactly one of three lists: free, held (key down) or
+// released (release tail still sounding). Sounding voices are also kept on
+// an age list ordered by note-on time, and note_to_voice indexes the voice
+// of every sounding note. New notes take a free voice first and only steal
+// when none is left or the voice limit is reached.
+class VoiceAllocator {
+  public:
+    enum StealPolicy {
+        STEAL_RELEASED_FIRST, // oldest release tail, else oldest held note
+        STEAL_OLDEST,         // oldest note-on, held or released
+        STEAL_QUIETEST,       // lowest envelope level
+        NUM_STEAL_POLICIES
+    };
+
+    struct Allocation {
+        int voice;       // voice to start the note on, -1 if none
+        int stolen_note; // note that voice was still playing, -1 if none
+        bool retrigger;  // the note was already on this voice (held or tail)
+    };
+
+    VoiceAllocator();
+
+    // levels (one per voice, Q8.24) is only read by STEAL_QUIETEST, the one
+    // policy that has to scan the sounding voices
+    Allocation note_on(uint8_t note, const q8_24_t *levels = nullptr);
+    // Returns the voice that starts releasing, -1 if the note is not held
+    int note_off(uint8_t note);
+    // The release tail of voice has ended, the voice is free again
+    void voice_finished(int voice);
+    // Take a sounding voice away (voice limit lowered). Returns the voice,
+    // or -1 when nothing is sounding, and the note it was playing.
+    int steal(const q8_24_t *levels = nullptr, int *stolen_note = nullptr);
+
+    int voice_for_note(uint8_t note) const { return note_to_voice[note]; }
+    int note_for_voice(int voice) const { return voices[voice].note; }
+    bool is_held(int voice) const { return voices[voice].list == HELD; }
+    bool is_released(int voice) const {
+        return voices[voice].list == RELEASED;
+    }
+    // First released voice, then follow next_released() to walk the tails
+    int first_released() const { return heads[RELEASED]; }
+    int next_released(int voice) const { return voices[voice].next; }
+
+    int active_count() const { return counts[HELD] + counts[RELEASED]; }
+    void set_policy(StealPolicy new_policy) { policy = new_policy; }
+    StealPolicy get_policy() const { return policy; }
+    void set_voice_limit(int limit);
+    int get_voice_limit() const { return voice_limit; }
+
+  private:
+    enum ListId { FREE, HELD, RELEASED, NUM_LISTS };
+
+    struct Voice {
+        int8_t prev, next;         // links within its list
+        int8_t age_prev, age_next; // links within the age list
+        uint8_t list;
+        int8_t note; // -1 when free
+    };
+
+    void unlink(int voice);
+    void push_back(ListId list, int voice);
+    void age_unlink(int voice);
+    void age_push_back(int voice);
+    int pick_victim(const q8_24_t *levels) const;
+    // Detach a sounding voice from its note and move it to the free list
+    void free_voice(int voice);
+
+    Voice voices[NUM_OSC];
+    int8_t heads[NUM_LISTS], tails[NUM_LISTS];
+    int counts[NUM_LISTS] = {};
+    int8_t age_head = -1, age_tail = -1;
+    int8_t note_to_voice[128];
+
+    StealPolicy policy = STEAL_RELEASED_FIRST;
+    int voice_limit = NUM_OSC;
+};
+
+const char *steal_policy_to_string(VoiceAllocator::StealPolicy policy);
+
+#endif // !VOICE_ALLOCATOR_HPP
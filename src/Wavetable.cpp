@@ -59,39 +59,111 @@ const std::array<int16_t, WAVE_TABLE_LEN> sinc_table{[]() {
     return table;
 }()};
 
-// Square Wavetable
-const std::array<int16_t, WAVE_TABLE_LEN> square_wave_table{[]() {
-    std::array<int16_t, WAVE_TABLE_LEN> table{};
+// Band-limited mipmaps, built by additive synthesis from the Fourier series
+// of each naive waveform. Everything is constexpr so the tables are computed
+// by the compiler and live in flash.
+namespace {
+
+// Taylor series, good to ~1e-12 on [-pi, pi]
+constexpr double cx_sin(double x) {
+    double term = x;
+    double sum = x;
+    for (int n = 1; n < 13; n++) {
+        term *= -x * x / ((2 * n) * (2 * n + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+// 2^x, the Taylor series of e^(f ln 2) for the fraction f, good to ~1e-16
+constexpr double cx_exp2(double x) {
+    int whole = static_cast<int>(x);
+    if (whole > x)
+        whole--;
+    double y = (x - whole) * 0.693147180559945309417;
+    double term = 1;
+    double sum = 1;
+    for (int n = 1; n < 20; n++) {
+        term *= y / n;
+        sum += term;
+    }
+    for (; whole > 0; whole--)
+        sum *= 2;
+    for (; whole < 0; whole++)
+        sum /= 2;
+    return sum;
+}
+
+constexpr std::array<double, WAVE_TABLE_LEN> cx_sine_table{[]() {
+    std::array<double, WAVE_TABLE_LEN> table{};
     for (int i = 0; i < WAVE_TABLE_LEN; i++) {
-        table[i] = (i < WAVE_TABLE_LEN / 2) ? 32767 : -32767;
+        double x = 2 * M_PI * i / WAVE_TABLE_LEN;
+        table[i] = cx_sin(x > M_PI ? x - 2 * M_PI : x);
     }
     return table;
 }()};
 
-// Triangle Wavetable
-const std::array<int16_t, WAVE_TABLE_LEN> triangle_wave_table{[]() {
-    std::array<int16_t, WAVE_TABLE_LEN> table{};
-    for (int i = 0; i < WAVE_TABLE_LEN; i++) {
-        float phase = static_cast<float>(i) / WAVE_TABLE_LEN;
-        if (phase < 0.5f) {
-            table[i] = static_cast<int16_t>(4 * 32767 * phase - 32767);
-        } else {
-            table[i] =
-                static_cast<int16_t>(-4 * 32767 * (phase - 0.5f) + 32767);
+enum class Harmonics { Square, Triangle, Sawtooth };
+
+// One period with harmonics 1..max_harmonic, normalized to full scale
+constexpr std::array<int16_t, WAVE_TABLE_LEN>
+bandlimited_table(Harmonics shape, int max_harmonic) {
+    std::array<double, WAVE_TABLE_LEN> sum{};
+    for (int k = 1; k <= max_harmonic; k++) {
+        double amp = 0;
+        int offset = 0; // quarter period offset turns sin into cos
+        switch (shape) {
+        case Harmonics::Square: // +1 then -1: sum of sin(kx)/k, k odd
+            amp = (k & 1) ? 1.0 / k : 0;
+            break;
+        case Harmonics::Triangle: // rising from -1: -sum of cos(kx)/k^2, k odd
+            amp = (k & 1) ? -1.0 / (k * k) : 0;
+            offset = WAVE_TABLE_LEN / 4;
+            break;
+        case Harmonics::Sawtooth: // rising from -1 to 1: -sum of sin(kx)/k
+            amp = -1.0 / k;
+            break;
+        }
+        if (amp == 0)
+            continue;
+        for (int i = 0; i < WAVE_TABLE_LEN; i++) {
+            sum[i] += amp * cx_sine_table[(k * i + offset) % WAVE_TABLE_LEN];
         }
     }
-    return table;
-}()};
 
-// Sawtooth Wavetable
-const std::array<int16_t, WAVE_TABLE_LEN> sawtooth_wave_table{[]() {
+    double peak = 0;
+    for (int i = 0; i < WAVE_TABLE_LEN; i++) {
+        double v = sum[i] < 0 ? -sum[i] : sum[i];
+        peak = v > peak ? v : peak;
+    }
+
     std::array<int16_t, WAVE_TABLE_LEN> table{};
     for (int i = 0; i < WAVE_TABLE_LEN; i++) {
-        float phase = static_cast<float>(i) / WAVE_TABLE_LEN;
-        table[i] = static_cast<int16_t>(2 * 32767 * phase - 32767);
+        double v = 32767 * sum[i] / peak;
+        table[i] = static_cast<int16_t>(v < 0 ? v - 0.5 : v + 0.5);
     }
     return table;
-}()};
+}
+
+constexpr WaveMipmap bandlimited_mipmap(Harmonics shape) {
+    WaveMipmap mipmap{};
+    for (int level = 0; level < WAVE_MIPMAP_LEVELS; level++) {
+        int max_harmonic = 256 >> level;
+        // Harmonic 256 would sit exactly on the table's own Nyquist
+        if (max_harmonic >= WAVE_TABLE_LEN / 2)
+            max_harmonic = WAVE_TABLE_LEN / 2 - 1;
+        mipmap[level] = bandlimited_table(shape, max_harmonic);
+    }
+    return mipmap;
+}
+
+} // namespace
+
+constexpr WaveMipmap square_mipmap = bandlimited_mipmap(Harmonics::Square);
+constexpr WaveMipmap triangle_mipmap =
+    bandlimited_mipmap(Harmonics::Triangle);
+constexpr WaveMipmap sawtooth_mipmap =
+    bandlimited_mipmap(Harmonics::Sawtooth);
 
 // Sinc Wavetable N = 32
 const std::array<q8_24_t, WAVE_TABLE_LEN> sinc_table_fp{[]() {
@@ -132,6 +204,57 @@ const std::array<int16_t, WAVE_TABLE_LEN> tan_wave_table{[]() {
     return table;
 }()};
 
+// Computed by the compiler like the mipmaps, so the table lives in flash
+constexpr std::array<uint32_t, PITCH_CENTS_PER_OCTAVE> pitch_table{[]() {
+    std::array<uint32_t, PITCH_CENTS_PER_OCTAVE> table{};
+    const int top_note = (PITCH_OCTAVES - 1) * 12;
+    for (int i = 0; i < PITCH_CENTS_PER_OCTAVE; i++) {
+        double freq = 440.0 * cx_exp2((top_note + i / 100.0 - 69) / 12.0);
+        table[i] = static_cast<uint32_t>(freq / 44100.0 * 4294967296.0 + 0.5);
+    }
+    return table;
+}()};
+
+const std::array<q8_24_t, SVF_TABLE_LEN> svf_tan_table{[]() {
+    std::array<q8_24_t, SVF_TABLE_LEN> table{};
+    for (int i = 0; i < SVF_TABLE_LEN; i++) {
+        double freq = 440.0 * pow(2.0, (SVF_FIRST_NOTE + i - 69) / 12.0);
+        table[i] = static_cast<q8_24_t>(Q24_ONE * tan(M_PI * freq / 44100.0));
+    }
+    return table;
+}()};
+
+// Zeroth-order modified Bessel function, for the Kaiser window
+static double bessel_i0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 30; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+const std::array<int16_t, HALFBAND_PAIRS> halfband_table{[]() {
+    // beta 6.5: flat within 0.01 dB to 18 kHz, -66 dB from 26.1 kHz
+    const double beta = 6.5;
+    const int centre = (HALFBAND_TAPS - 1) / 2;
+    std::array<double, HALFBAND_PAIRS> taps{};
+    double sum = 0.5;
+    for (int j = 0; j < HALFBAND_PAIRS; j++) {
+        int n = 2 * j + 1;
+        double r = (double)n / centre;
+        double window = bessel_i0(beta * sqrt(1.0 - r * r)) / bessel_i0(beta);
+        taps[j] = sin(M_PI * n / 2.0) / (M_PI * n) * window;
+        sum += 2.0 * taps[j];
+    }
+    // Unity gain at DC
+    std::array<int16_t, HALFBAND_PAIRS> table{};
+    for (int j = 0; j < HALFBAND_PAIRS; j++) {
+        table[j] = static_cast<int16_t>(lround(32768.0 * taps[j] / sum));
+    }
+    return table;
+}()};
+
 // Lookup tables for sinh, cosh, and u approximations
 const std::array<int16_t, WAVE_TABLE_LEN> sinh_wave_table{[]() {
     std::array<int16_t, WAVE_TABLE_LEN> table{};
@@ -8,17 +8,35 @@
 #define WAVE_TABLE_LEN 512
 #define FILTER_ORDER 33
 
+// One band-limited table per octave: level l keeps 256 >> l harmonics
+#define WAVE_MIPMAP_LEVELS 9
+
 
 enum WaveType { Sine, Square, Triangle, Sawtooth, Sinc};
 
 const char* wave_type_to_string(WaveType type); 
 
 extern const std::array<int16_t, WAVE_TABLE_LEN> sine_wave_table;
-extern const std::array<int16_t, WAVE_TABLE_LEN> square_wave_table;
-extern const std::array<int16_t, WAVE_TABLE_LEN> triangle_wave_table;
-extern const std::array<int16_t, WAVE_TABLE_LEN> sawtooth_wave_table;
 extern const std::array<int16_t, WAVE_TABLE_LEN> sinc_table;
 
+typedef std::array<std::array<int16_t, WAVE_TABLE_LEN>, WAVE_MIPMAP_LEVELS>
+    WaveMipmap;
+
+extern const WaveMipmap square_mipmap;
+extern const WaveMipmap triangle_mipmap;
+extern const WaveMipmap sawtooth_mipmap;
+
+// Mipmap level whose harmonics all stay below Nyquist for a phase step in
+// 16.16 table samples per output sample. Level l is clean up to a step of
+// 2^(16 + l), i.e. about 86 Hz << l.
+inline int wave_mipmap_level(uint32_t step) {
+    uint32_t octaves = (step - 1) >> 16;
+    if (step == 0 || octaves == 0)
+        return 0;
+    int level = 32 - __builtin_clz(octaves);
+    return level < WAVE_MIPMAP_LEVELS ? level : WAVE_MIPMAP_LEVELS - 1;
+}
+
 
 extern const std::array<int16_t, WAVE_TABLE_LEN> cos_wave_table;
 extern const std::array<int16_t, WAVE_TABLE_LEN> tan_wave_table;
@@ -26,6 +44,41 @@ extern const std::array<int16_t, WAVE_TABLE_LEN> cosh_wave_table;
 extern const std::array<int16_t, WAVE_TABLE_LEN> sinh_wave_table;
 extern const std::array<int16_t, WAVE_TABLE_LEN> u_wave_table;
 
+// Phase increment per 44.1 kHz sample, 2^32 per cycle, at every cent of
+// the top octave (MIDI notes 120 to 131). pitch_to_step() shifts it down
+// to the lower ones.
+#define PITCH_OCTAVES 11
+#define PITCH_CENTS_PER_OCTAVE 1200
+#define PITCH_MAX_CENTS (PITCH_OCTAVES * PITCH_CENTS_PER_OCTAVE - 1)
+extern const std::array<uint32_t, PITCH_CENTS_PER_OCTAVE> pitch_table;
+
+// Phase increment of a pitch in cents above MIDI note 0 (8.18 Hz), held
+// to notes 0 to 131. One divide by a constant and a table read.
+inline uint32_t pitch_to_step(int32_t cents) {
+    if (cents < 0)
+        cents = 0;
+    if (cents > PITCH_MAX_CENTS)
+        cents = PITCH_MAX_CENTS;
+    uint32_t octave = (uint32_t)cents / PITCH_CENTS_PER_OCTAVE;
+    uint32_t cent = (uint32_t)cents - octave * PITCH_CENTS_PER_OCTAVE;
+    return pitch_table[cent] >> (PITCH_OCTAVES - 1 - octave);
+}
+
+// tan(pi f / fs) at every MIDI note from SVF_FIRST_NOTE (20.6 Hz) to
+// SVF_FIRST_NOTE + SVF_TABLE_LEN - 1 (15.8 kHz), the prewarped cutoff of
+// the state variable filter
+#define SVF_FIRST_NOTE 16
+#define SVF_TABLE_LEN 116
+extern const std::array<q8_24_t, SVF_TABLE_LEN> svf_tan_table;
+
+// Half-band low-pass for the 88.2 to 44.1 kHz decimator, Kaiser windowed
+// sinc with HALFBAND_TAPS taps. Every other tap is zero and the centre one
+// is 1/2, the table holds the rest in Q15: entry j is the tap 2j + 1 away
+// from the centre, on both sides.
+#define HALFBAND_TAPS 47
+#define HALFBAND_PAIRS ((HALFBAND_TAPS + 1) / 4)
+extern const std::array<int16_t, HALFBAND_PAIRS> halfband_table;
+
 extern const std::array<q8_24_t, WAVE_TABLE_LEN> sinc_table_fp;
 extern const std::array<q8_24_t, FILTER_ORDER> hanning_window_table_fp;
 
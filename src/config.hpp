@@ -1,6 +1,40 @@
 #ifndef CONFIG_HPP
 #define CONFIG_HPP
 
+// Largest block any latency profile renders, buffers are sized with it. The
+// block actually rendered is chosen at runtime (see latency_profiles).
 #define SAMPLES_PER_BUFFER 578
 
+// Polyphony, the number of voices the synth renders
+#ifndef NUM_OSC
+#define NUM_OSC 8
+#endif
+
+// Index into latency_profiles used at boot (cycle with 'l')
+#ifndef DEFAULT_LATENCY_PROFILE
+#define DEFAULT_LATENCY_PROFILE 3
+#endif
+
+// Split voice rendering across both cores at boot (toggle with 'm')
+#ifndef SYNTH_DUAL_CORE
+#define SYNTH_DUAL_CORE 0
+#endif
+
+// Timestamped MIDI packets waiting for the block they fall in. Must be a
+// power of two.
+#ifndef MIDI_EVENT_SLOTS
+#define MIDI_EVENT_SLOTS 64
+#endif
+
+// Queued transactions per I2C controller, a keypad scan takes 5. Must be a
+// power of two.
+#ifndef I2C_QUEUE_SLOTS
+#define I2C_QUEUE_SLOTS 16
+#endif
+
+// Per-stage cycle profiler (see Profiler.hpp), on in Debug builds
+#ifndef SYNTH_PROFILE
+#define SYNTH_PROFILE 0
+#endif
+
 #endif // !CONFIG_HPP
@@ -9,9 +9,31 @@ audio_buffer_pool_t *ap;
 bool decode_flg = false;
 static constexpr int32_t DAC_ZERO = 1;
 
+constexpr LatencyProfile latency_profiles[NUM_LATENCY_PROFILES] = {
+    {.name = "64x4", .samples_per_buffer = 64, .buffer_count = 4},
+    {.name = "128x3", .samples_per_buffer = 128, .buffer_count = 3},
+    {.name = "256x2", .samples_per_buffer = 256, .buffer_count = 2},
+    {.name = "578x3", .samples_per_buffer = 578, .buffer_count = 3},
+};
+
+// The renderer's buffers hold SAMPLES_PER_BUFFER samples, and main.cpp
+// renders samples_per_buffer of them per block
+static constexpr bool profiles_fit() {
+    for (const LatencyProfile &profile : latency_profiles) {
+        if (profile.samples_per_buffer > SAMPLES_PER_BUFFER)
+            return false;
+    }
+    return true;
+}
+static_assert(profiles_fit(),
+              "a latency profile is longer than SAMPLES_PER_BUFFER");
+
+// The producer pool allocates its buffer headers as one array, remember it
+// so deinit can free every buffer, including any the DMA still held
+static audio_buffer_t *pool_buffers = nullptr;
+static uint pool_buffer_count = 0;
+
 #define audio_pio __CONCAT(pio, PICO_AUDIO_I2S_PIO)
-// #define SAMPLES_PER_BUFFER 1156 // Samples / channel
-// #define SAMPLES_PER_BUFFER 512 // Samples / channel
 
 static audio_format_t audio_format = {.sample_freq = 44100,
                                       .pcm_format = AUDIO_PCM_FORMAT_S32,
@@ -37,35 +59,31 @@ void i2s_audio_deinit() {
     audio_i2s_set_enabled(false);
     audio_i2s_end();
 
-    audio_buffer_t *ab;
-    ab = take_audio_buffer(ap, false);
-    while (ab != nullptr) {
-        free(ab->buffer->bytes);
-        free(ab->buffer);
-        ab = take_audio_buffer(ap, false);
-    }
-    ab = get_free_audio_buffer(ap, false);
-    while (ab != nullptr) {
-        free(ab->buffer->bytes);
-        free(ab->buffer);
-        ab = get_free_audio_buffer(ap, false);
-    }
-    ab = get_full_audio_buffer(ap, false);
-    while (ab != nullptr) {
-        free(ab->buffer->bytes);
-        free(ab->buffer);
-        ab = get_full_audio_buffer(ap, false);
+    for (uint i = 0; i < pool_buffer_count; i++) {
+        free(pool_buffers[i].buffer->bytes);
+        free(pool_buffers[i].buffer);
     }
+    free(pool_buffers);
+    pool_buffers = nullptr;
+    pool_buffer_count = 0;
+
     free(ap);
     ap = nullptr;
 }
 
-audio_buffer_pool_t *i2s_audio_init(uint32_t sample_freq) {
+audio_buffer_pool_t *i2s_audio_init(uint32_t sample_freq,
+                                    uint samples_per_buffer,
+                                    uint buffer_count) {
     audio_format.sample_freq = sample_freq;
+    // Callers size their blocks from the same value, a clamp here would
+    // leave them rendering past the end of the buffers
+    assert(samples_per_buffer <= SAMPLES_PER_BUFFER);
 
-    audio_buffer_pool_t *producer_pool =
-        audio_new_producer_pool(&producer_format, 3, SAMPLES_PER_BUFFER);
+    audio_buffer_pool_t *producer_pool = audio_new_producer_pool(
+        &producer_format, buffer_count, samples_per_buffer);
     ap = producer_pool;
+    pool_buffers = producer_pool->free_list;
+    pool_buffer_count = buffer_count;
 
     bool __unused ok;
     const audio_format_t *output_format;
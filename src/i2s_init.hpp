@@ -10,8 +10,21 @@ extern audio_buffer_pool_t *ap;
 extern bool decode_flg;
 extern const uint32_t PIN_DCDC_PSM_CTRL;
 
+// Buffer size and count the DMA plays from. Fewer, shorter buffers mean less
+// latency but more per-buffer overhead and less slack for the renderer.
+struct LatencyProfile {
+    const char *name;
+    uint16_t samples_per_buffer; // at most SAMPLES_PER_BUFFER
+    uint8_t buffer_count;
+};
+
+#define NUM_LATENCY_PROFILES 4
+extern const LatencyProfile latency_profiles[NUM_LATENCY_PROFILES];
+
 // Initializes I2S audio and returns a pointer to the buffer pool
-audio_buffer_pool_t *i2s_audio_init(uint32_t sample_freq);
+audio_buffer_pool_t *i2s_audio_init(uint32_t sample_freq,
+                                    uint samples_per_buffer = SAMPLES_PER_BUFFER,
+                                    uint buffer_count = 3);
 
 // Deinitializes I2S audio, freeing resources
 void i2s_audio_deinit();
@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <array>
+#include <cassert>
 #include <cstdint>
 #include <stdio.h>
 
@@ -20,20 +22,107 @@
 #include "quadrature_encoder.pio.h"
 
 #include "Envelope.hpp"
+#include "Governor.hpp"
 #include "HardwareManager.hpp"
 #include "MidiHandler.hpp"
 #include "Oscillator.hpp"
+#include "Profiler.hpp"
 #include "Synth.hpp"
+#include "Telemetry.hpp"
 #include "Wavetable.hpp"
 #include "i2s_init.hpp"
 
-uint vol = 100;
+// Buffers handed to the DMA and buffers it has finished, the difference is
+// how far the main loop has rendered ahead. Only the callback writes
+// buffers_played.
+uint32_t buffers_given = 0;
+volatile uint32_t buffers_played = 0;
+// When the DMA last finished a buffer
+volatile uint32_t last_played_us = 0;
+
+// Underruns and late renders, printed with 't'
+AudioTelemetry telemetry;
+
+// Active latency profile and the render time spent since it was selected
+int latency_profile = DEFAULT_LATENCY_PROFILE;
+uint block_size = SAMPLES_PER_BUFFER;
+uint64_t render_us_total = 0;
+uint32_t render_count = 0;
+
+// Restart the I2S output with another buffer size and count
+void set_latency_profile(int index) {
+    const LatencyProfile &old_profile = latency_profiles[latency_profile];
+    if (render_count > 0) {
+        uint32_t avg_us = render_us_total / render_count;
+        printf("Profile %s: %lu us/buffer, %lu ns/sample\n", old_profile.name,
+               avg_us, avg_us * 1000 / old_profile.samples_per_buffer);
+    }
+
+    if (ap != nullptr)
+        i2s_audio_deinit();
+
+    latency_profile = index;
+    const LatencyProfile &profile = latency_profiles[index];
+    block_size = profile.samples_per_buffer;
+    render_us_total = 0;
+    render_count = 0;
+    // buffers_played and last_played_us belong to the DMA callback. They
+    // may only be written here because i2s_audio_deinit() has stopped it.
+    assert(ap == nullptr);
+    // Restart the count with the buffer of silence i2s_audio_init() queues
+    buffers_given = 1;
+    buffers_played = 0;
+    last_played_us = time_us_32();
+    ap = i2s_audio_init(44100, profile.samples_per_buffer,
+                        profile.buffer_count);
+
+    printf("Latency profile %s: %lu us\n", profile.name,
+           (uint32_t)profile.samples_per_buffer * profile.buffer_count *
+               1000000 / 44100);
+}
+
+// Render one block straight into a buffer taken from the producer pool. The
+// mono mix goes into the last quarter of the buffer and is widened to S32
+// stereo in place, front to back: frame i ends before sample i + 1 starts,
+// so no sample is overwritten before it is read.
+void render_buffer(Synth &synth, audio_buffer_t *buffer) {
+    uint size = buffer->max_sample_count;
+    const int32_t vol = synth.get_render_volume();
+    int32_t *frames = (int32_t *)buffer->buffer->bytes;
+    int16_t *mono = (int16_t *)(frames + size) + size;
+    synth.out(mono, size);
+
+    PROFILE_START(convert_start);
+    for (uint i = 0; i < size; i++) {
+        int32_t value = (vol * mono[i]) << 8u;
+        // use 32bit full scale
+        value += value >> 16u;
+        frames[i * 2 + 0] = value; // L
+        frames[i * 2 + 1] = value; // R
+    }
+    PROFILE_STOP(PROF_CONVERT, convert_start);
+    PROFILE_COMMIT(PROF_CONVERT);
+    buffer->sample_count = size;
+}
 
-// Double output buffer
-std::array<int16_t, SAMPLES_PER_BUFFER> out1 = {};
-std::array<int16_t, SAMPLES_PER_BUFFER> out2 = {};
-bool write_flag = 0;
-bool buff = 0;
+// The synth sample that plays one latency profile from now. Scheduling
+// every MIDI event that far ahead gives it the same delay whenever it
+// arrives, instead of whatever is left until the next block is rendered.
+uint32_t midi_sample_time(const Synth &synth) {
+    const LatencyProfile &profile = latency_profiles[latency_profile];
+    uint32_t block_us = block_size * 1000000 / 44100;
+
+    // The next block starts playing once the buffers queued have, or the
+    // buffer of silence after an underrun
+    uint32_t irq_state = save_and_disable_interrupts();
+    uint32_t queued = std::max<uint32_t>(buffers_given - buffers_played, 1);
+    uint32_t start_us = last_played_us + queued * block_us;
+    restore_interrupts(irq_state);
+
+    int32_t lead_us =
+        (int32_t)(time_us_32() + profile.buffer_count * block_us - start_us);
+    return synth.get_sample_clock() + lead_us * 441 / 10000;
+}
 
 void setup_gpios(void) {
     // Enable less noise in audio output
@@ -71,8 +160,12 @@ int main() {
     // Initialize TinyUSB
     tusb_init();
 
+#if SYNTH_PROFILE
+    profile_init();
+#endif
+
     // Initialize I2S audio output
-    ap = i2s_audio_init(44100);
+    set_latency_profile(DEFAULT_LATENCY_PROFILE);
 
     setup_gpios();
 
@@ -88,6 +181,7 @@ int main() {
     // ssd1306_clear(&disp);
 
     Synth synth = Synth();
+    synth.set_dual_core(SYNTH_DUAL_CORE);
 
     MidiHandler midi_handler = MidiHandler(synth);
 
@@ -99,6 +193,8 @@ int main() {
     // static WaveType last_wave_type = static_cast<WaveType>(-1);
     HardwareManager hw = HardwareManager(synth);
 
+    RenderGovernor governor = RenderGovernor(synth);
+
     hw.init();
 
     while (true) {
@@ -107,25 +203,65 @@ int main() {
         tud_task();
 
         // Handle MIDI messages
-        midi_handler.midi_task();
+        midi_handler.midi_task(midi_sample_time(synth));
 
         hw.update();
         // prev_state = curr_state;
 
         int c = getchar_timeout_us(0);
         if (c >= 0) {
-            if (c == '-' && vol)
-                vol--;
-            if ((c == '=' || c == '+') && vol < 256)
-                vol++;
+            if (c == '-' && synth.get_volume())
+                synth.set_volume(synth.get_volume() - 1);
+            if (c == '=' || c == '+')
+                synth.set_volume(synth.get_volume() + 1);
+            if (c == 'm')
+                synth.set_dual_core(!synth.is_dual_core());
+            if (c == 'i')
+                synth.set_interp_mode(static_cast<InterpMode>(
+                    (synth.get_interp_mode() + 1) % NUM_INTERP_MODES));
+            if (c == 'e')
+                synth.set_osc_engine(static_cast<OscEngine>(
+                    (synth.get_osc_engine() + 1) % NUM_OSC_ENGINES));
+            if (c == 'g')
+                governor.print_stats();
+            if (c == 't')
+                telemetry.print();
+            if (c == 'T')
+                telemetry.reset();
+#if SYNTH_PROFILE
+            if (c == 'c')
+                profile_print(block_size);
+            if (c == 'C')
+                profile_reset();
+#endif
+            if (c == 'v')
+                synth.set_steal_policy(static_cast<VoiceAllocator::StealPolicy>(
+                    (synth.get_steal_policy() + 1) %
+                    VoiceAllocator::NUM_STEAL_POLICIES));
+            if (c == 'f')
+                synth.set_svf_mode(static_cast<SvfMode>(
+                    (synth.get_svf_mode() + 1) % NUM_SVF_MODES));
+            if (c == 'r')
+                synth.set_filter_resonance(synth.get_filter_resonance() *
+                                           1.25f);
+            if (c == 'R')
+                synth.set_filter_resonance(synth.get_filter_resonance() /
+                                           1.25f);
+            if (c == 'o')
+                synth.set_oversampling(!synth.is_oversampling());
+            if (c == 'w')
+                synth.set_voice_filter(!synth.is_voice_filter_enabled());
+            if (c == 'l')
+                set_latency_profile((latency_profile + 1) %
+                                    NUM_LATENCY_PROFILES);
             // if (c == 's')
             // env1.set_trigger(5.0);
             if (c == 'p') {
 
                 // env1.set_trigger(0.0);
-                synth.low_pass.recalculate_coefficients();
-                for (int i = 0; i < 33; i++) {
-                    printf("h = %f\n\r", q24_to_float(synth.low_pass.h[i]));
+                const FirCoefficients &fir = synth.low_pass.get_coefficients();
+                for (int i = 0; i < fir.num_taps; i++) {
+                    printf("h = %f\n\r", q24_to_float(fir.h[i]));
                 }
             }
             if (c == 'q')
@@ -134,50 +270,44 @@ int main() {
                 }
             printf("Yo\n\r");
         }
-        if (write_flag) {
-            if (buff) {
-                synth.out();
-                out1 = synth.get_output();
-                write_flag = 0;
-            } else {
-                synth.out();
-                out1 = synth.get_output();
-                write_flag = 0;
-            }
-        }
-
-        else {
-            // without this print the thing does not work,
-            // main loop runs too fast atm, no time for interrupt
-            // is what Im assuming
-            // thats a good thing at least
-            // printf("Not writing anything\n");
-            // __wfe(); // Wait for event (low power waiting)
+        // Render ahead into every free buffer of the pool, one per pass so
+        // USB and UI stay responsive
+        audio_buffer_t *buffer = take_audio_buffer(ap, false);
+        if (buffer != nullptr) {
+            // Controller moves since the last block become one update
+            synth.update_controls();
+            uint32_t start_us = time_us_32();
+            render_buffer(synth, buffer);
+            uint32_t render_us = time_us_32() - start_us;
+            render_us_total += render_us;
+            render_count++;
+            uint32_t deadline_us = block_size * 1000000 / 44100;
+            governor.update(render_us, deadline_us);
+            uint32_t irq_state = save_and_disable_interrupts();
+            give_audio_buffer(ap, buffer);
+            buffers_given++;
+            restore_interrupts(irq_state);
+            telemetry.render_done(render_us, deadline_us);
         }
     }
 
     return 0;
 }
 
-void decode() {
-    audio_buffer_t *buffer = take_audio_buffer(ap, false);
-    if (buffer == NULL) {
-        return;
+// Called once per buffer the DMA has finished. The buffers themselves are
+// taken, filled and queued by the main loop, this only keeps count.
+void buffer_played() {
+    last_played_us = time_us_32();
+    uint32_t played = buffers_played + 1;
+    if ((int32_t)(buffers_given - played) < 0) {
+        // That was a buffer of silence the DMA played on its own
+        played = buffers_given;
     }
-    int32_t *samples = (int32_t *)buffer->buffer->bytes;
-    std::array<int16_t, SAMPLES_PER_BUFFER> &out = (buff) ? out1 : out1;
-    for (uint i = 0; i < buffer->max_sample_count; i++) {
-        int32_t value0 = (vol * out[i]) << 8u;
-        int32_t value1 = (vol * out[i]) << 8u;
-        // use 32bit full scale
-        samples[i * 2 + 0] = value0 + (value0 >> 16u); // L
-        samples[i * 2 + 1] = value1 + (value1 >> 16u); // R
+    buffers_played = played;
+    if (played == buffers_given) {
+        // Nothing queued, the next buffer is silence
+        telemetry.record(AudioTelemetry::EVENT_UNDERRUN);
     }
-    buff = !buff;
-    write_flag = 1;
-    buffer->sample_count = buffer->max_sample_count;
-    give_audio_buffer(ap, buffer);
-    return;
 }
 
 extern "C" {
@@ -187,7 +317,7 @@ extern "C" {
 //   where i2s_callback_func() is declared with __attribute__((weak))
 void i2s_callback_func() {
     if (decode_flg) {
-        decode();
+        buffer_played();
     }
 }
 }
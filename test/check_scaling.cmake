@@ -0,0 +1,17 @@
+# Runs the allocator timing of the SMALL and LARGE builds. With eight times
+# the voices an event may not get much dearer, a scan over them would.
+foreach(build SMALL LARGE)
+    execute_process(COMMAND ${${build}} --timing
+                    OUTPUT_VARIABLE ${build}_TIME
+                    RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${${build}} --timing failed")
+    endif()
+    string(STRIP "${${build}_TIME}" ${build}_TIME)
+endforeach()
+
+message("0.1 ns/event: ${SMALL_TIME} small, ${LARGE_TIME} large")
+math(EXPR limit "${SMALL_TIME} * 2")
+if(LARGE_TIME GREATER limit)
+    message(FATAL_ERROR "allocator cost grows with the voice count")
+endif()
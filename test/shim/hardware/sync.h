@@ -0,0 +1,26 @@
+#ifndef SHIM_HARDWARE_SYNC_H
+#define SHIM_HARDWARE_SYNC_H
+
+#include "pico/types.h"
+#include <atomic>
+
+// The SIO spinlocks are atomic flags, taking one spins on the host thread
+// and there are no interrupts to mask. Acquire and release order the data
+// they guard like the barriers of the SDK versions.
+typedef std::atomic_flag spin_lock_t;
+
+spin_lock_t *spin_lock_instance(uint lock_num);
+uint next_striped_spin_lock_num(void);
+
+static inline uint32_t spin_lock_blocking(spin_lock_t *lock) {
+    while (lock->test_and_set(std::memory_order_acquire)) {
+    }
+    return 0;
+}
+
+static inline void spin_unlock(spin_lock_t *lock, uint32_t saved_irq) {
+    (void)saved_irq; // no interrupts on the host
+    lock->clear(std::memory_order_release);
+}
+
+#endif // !SHIM_HARDWARE_SYNC_H
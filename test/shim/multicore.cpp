@@ -0,0 +1,49 @@
+#include "pico/multicore.h"
+#include "pico/platform.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+struct Fifo {
+    std::mutex lock;
+    std::condition_variable ready;
+    std::deque<uint32_t> words;
+};
+
+// fifos[c] is the one core c pops from. Never destroyed, core 1 is still
+// waiting on its FIFO when the process exits.
+Fifo *const fifos = new Fifo[2];
+thread_local uint core_num = 0;
+
+} // namespace
+
+uint get_core_num(void) { return core_num; }
+
+void multicore_launch_core1(void (*entry)(void)) {
+    // Never joined, like the real core 1 it runs until the process ends
+    std::thread([entry] {
+        core_num = 1;
+        entry();
+    }).detach();
+}
+
+void multicore_fifo_push_blocking(uint32_t data) {
+    Fifo &fifo = fifos[1 - core_num];
+    {
+        std::lock_guard<std::mutex> guard(fifo.lock);
+        fifo.words.push_back(data);
+    }
+    fifo.ready.notify_one();
+}
+
+uint32_t multicore_fifo_pop_blocking(void) {
+    Fifo &fifo = fifos[core_num];
+    std::unique_lock<std::mutex> guard(fifo.lock);
+    fifo.ready.wait(guard, [&] { return !fifo.words.empty(); });
+    uint32_t data = fifo.words.front();
+    fifo.words.pop_front();
+    return data;
+}
@@ -0,0 +1,12 @@
+#ifndef SHIM_PICO_MULTICORE_H
+#define SHIM_PICO_MULTICORE_H
+
+#include "pico/types.h"
+
+// Core 1 is a host thread, the inter-core FIFOs are blocking queues, so the
+// split render really runs in parallel with core 0
+void multicore_launch_core1(void (*entry)(void));
+void multicore_fifo_push_blocking(uint32_t data);
+uint32_t multicore_fifo_pop_blocking(void);
+
+#endif // !SHIM_PICO_MULTICORE_H
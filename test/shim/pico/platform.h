@@ -0,0 +1,11 @@
+#ifndef SHIM_PICO_PLATFORM_H
+#define SHIM_PICO_PLATFORM_H
+
+#include "pico/types.h"
+
+#define __not_in_flash_func(x) x
+
+// 0 on the test thread, 1 on the thread started by multicore_launch_core1()
+uint get_core_num(void);
+
+#endif // !SHIM_PICO_PLATFORM_H
@@ -0,0 +1,9 @@
+#ifndef SHIM_PICO_TYPES_H
+#define SHIM_PICO_TYPES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef unsigned int uint;
+
+#endif // !SHIM_PICO_TYPES_H
@@ -0,0 +1,22 @@
+#include "hardware/sync.h"
+
+namespace {
+
+// Numbered like the RP2040's, the striped ones are handed out in turn
+constexpr uint NUM_SPIN_LOCKS = 32;
+constexpr uint FIRST_STRIPED = 16;
+constexpr uint NUM_STRIPED = 8;
+
+// Zero initialized, so every flag starts clear
+spin_lock_t spin_locks[NUM_SPIN_LOCKS];
+std::atomic<uint> striped_count{0};
+
+} // namespace
+
+spin_lock_t *spin_lock_instance(uint lock_num) {
+    return &spin_locks[lock_num];
+}
+
+uint next_striped_spin_lock_num(void) {
+    return FIRST_STRIPED + striped_count.fetch_add(1) % NUM_STRIPED;
+}
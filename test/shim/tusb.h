@@ -0,0 +1,14 @@
+#ifndef SHIM_TUSB_H
+#define SHIM_TUSB_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// No USB device on the host, MIDI never has a packet waiting
+static inline bool tud_midi_available(void) { return false; }
+static inline bool tud_midi_packet_read(uint8_t *packet) {
+    (void)packet;
+    return false;
+}
+
+#endif // !SHIM_TUSB_H
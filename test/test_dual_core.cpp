@@ -0,0 +1,176 @@
+// Renders the same note sequence with every voice on one core and with the
+// voices split across both, and checks the outputs are bit-identical, with
+// and without oversampling and per-voice filters. One run drives the mix
+// far past full scale, both must clip it the same way.
+#include "Synth.hpp"
+#include <cstdio>
+#include <memory>
+
+// Small LCG, the sequence must be the same for both synths and every run
+static uint32_t random_state = 1;
+static uint32_t next_random() {
+    random_state = random_state * 1664525u + 1013904223u;
+    return random_state >> 8;
+}
+
+struct Scenario {
+    const char *name;
+    OscEngine engine;
+    InterpMode interp;
+    WaveType wave;
+    FilterType filter;
+    bool oversampling;
+    bool voice_filter;
+};
+
+static void configure(Synth &synth, const Scenario &scenario) {
+    synth.set_osc_engine(scenario.engine);
+    synth.set_interp_mode(scenario.interp);
+    synth.set_wave_type(scenario.wave);
+    SynthParams &params = synth.edit_params();
+    params.filter_type = scenario.filter;
+    params.oversampling = scenario.oversampling;
+    params.voice_filter = scenario.voice_filter;
+    synth.publish_params();
+    // What the main loop does before each block
+    synth.update_controls();
+}
+
+// Returns the number of mismatching samples, or -1 if core 1 never had a
+// voice to render
+static long run(const Scenario &scenario, Synth &single, Synth &dual) {
+    configure(single, scenario);
+    configure(dual, scenario);
+
+    random_state = 1;
+    int16_t a[SAMPLES_PER_BUFFER];
+    int16_t b[SAMPLES_PER_BUFFER];
+    long mismatches = 0;
+    int split_blocks = 0;
+    for (int block = 0; block < 400; block++) {
+        const size_t size = 64 + next_random() % (SAMPLES_PER_BUFFER - 63);
+
+        // A few notes per block, on their own samples inside it, so both
+        // halves of the voices start, steal and release
+        const uint32_t clock = single.get_sample_clock();
+        const int events = next_random() % 4;
+        for (int e = 0; e < events; e++) {
+            uint8_t note = 48 + next_random() % 24;
+            bool on = next_random() % 3 != 0;
+            uint32_t sample = clock + next_random() % size;
+            const uint8_t packet[4] = {(uint8_t)(on ? 0x09 : 0x08),
+                                       (uint8_t)(on ? 0x90 : 0x80), note,
+                                       (uint8_t)(on ? 100 : 0)};
+            single.queue_midi_packet(packet, sample);
+            dual.queue_midi_packet(packet, sample);
+        }
+
+        split_blocks += dual.any_voice_active(CORE1_FIRST_VOICE, NUM_OSC);
+        single.out(a, size);
+        dual.out(b, size);
+        for (size_t k = 0; k < size; k++) {
+            if (a[k] != b[k]) {
+                if (mismatches == 0)
+                    printf("  first mismatch: block %d sample %zu, %d vs %d\n",
+                           block, k, a[k], b[k]);
+                mismatches++;
+            }
+        }
+    }
+    if (split_blocks == 0) {
+        printf("  core 1 never rendered\n");
+        return -1;
+    }
+    return mismatches;
+}
+
+// A chord on every voice through resonant per-voice filters, far louder
+// than full scale. Returns the number of mismatching samples, or -1 if the
+// mix never clipped.
+static long run_loud(Synth &single, Synth &dual) {
+    for (Synth *synth : {&single, &dual}) {
+        synth->set_osc_engine(ENGINE_WAVETABLE);
+        synth->set_interp_mode(INTERP_TRUNCATE);
+        synth->set_wave_type(Sawtooth);
+        SynthParams &params = synth->edit_params();
+        params.filter_type = FILTER_OFF;
+        params.voice_filter = true;
+        synth->publish_params();
+        synth->set_voice_filter_cutoff(1000.f, 0.f);
+        synth->set_voice_filter_resonance(SVF_MAX_Q);
+        synth->update_controls();
+    }
+
+    // Drop whatever the last scenario left sounding
+    for (int note = 0; note < 128; note++) {
+        const uint8_t packet[4] = {0x08, 0x80, (uint8_t)note, 0};
+        single.queue_midi_packet(packet, single.get_sample_clock());
+        dual.queue_midi_packet(packet, dual.get_sample_clock());
+    }
+    for (int v = 0; v < NUM_OSC; v++) {
+        const uint8_t packet[4] = {0x09, 0x90, (uint8_t)(36 + 7 * v), 127};
+        single.queue_midi_packet(packet, single.get_sample_clock() + 1);
+        dual.queue_midi_packet(packet, dual.get_sample_clock() + 1);
+    }
+
+    int16_t a[SAMPLES_PER_BUFFER];
+    int16_t b[SAMPLES_PER_BUFFER];
+    long mismatches = 0;
+    long clipped = 0;
+    for (int block = 0; block < 200; block++) {
+        single.out(a, 256);
+        dual.out(b, 256);
+        for (size_t k = 0; k < 256; k++) {
+            clipped += a[k] == INT16_MAX || a[k] == INT16_MIN;
+            if (a[k] != b[k]) {
+                if (mismatches == 0)
+                    printf("  first mismatch: block %d sample %zu, %d vs %d\n",
+                           block, k, a[k], b[k]);
+                mismatches++;
+            }
+        }
+    }
+    printf("  %ld clipped samples\n", clipped);
+    return clipped > 0 ? mismatches : -1;
+}
+
+int main() {
+    const Scenario scenarios[] = {
+        {"wavetable saw, Chebyshev", ENGINE_WAVETABLE, INTERP_TRUNCATE,
+         Sawtooth, FILTER_CHEBYSHEV, false, false},
+        {"wavetable square, Hermite, FIR", ENGINE_WAVETABLE, INTERP_HERMITE,
+         Square, FILTER_LOW_PASS, false, false},
+        {"PolyBLEP saw, SVF", ENGINE_POLYBLEP, INTERP_TRUNCATE, Sawtooth,
+         FILTER_SVF, false, false},
+        {"wavetable triangle, no filter", ENGINE_WAVETABLE, INTERP_LINEAR,
+         Triangle, FILTER_OFF, false, false},
+        // The shared 88.2 kHz bus, decimated once for both cores
+        {"wavetable saw, oversampled", ENGINE_WAVETABLE, INTERP_TRUNCATE,
+         Sawtooth, FILTER_CHEBYSHEV, true, false},
+        {"PolyBLEP square, oversampled", ENGINE_POLYBLEP, INTERP_TRUNCATE,
+         Square, FILTER_OFF, true, false},
+        {"wavetable saw, voice filters", ENGINE_WAVETABLE, INTERP_LINEAR,
+         Sawtooth, FILTER_SVF, false, true},
+        {"PolyBLEP saw, oversampled voice filters", ENGINE_POLYBLEP,
+         INTERP_TRUNCATE, Sawtooth, FILTER_OFF, true, true},
+    };
+
+    // Core 1 serves a single synth for the life of the process
+    auto single = std::make_unique<Synth>();
+    auto dual = std::make_unique<Synth>();
+    dual->set_dual_core(true);
+
+    int failures = 0;
+    for (const Scenario &scenario : scenarios) {
+        long mismatches = run(scenario, *single, *dual);
+        printf("%-40s %s (%ld mismatching samples)\n", scenario.name,
+               mismatches == 0 ? "ok" : "FAIL", mismatches);
+        failures += mismatches != 0;
+    }
+
+    long mismatches = run_loud(*single, *dual);
+    printf("%-40s %s (%ld mismatching samples)\n", "mix past full scale",
+           mismatches == 0 ? "ok" : "FAIL", mismatches);
+    failures += mismatches != 0;
+    return failures == 0 ? 0 : 1;
+}
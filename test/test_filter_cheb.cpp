@@ -0,0 +1,252 @@
+// Checks of FilterCheb across its whole cutoff range.
+//
+// A DC input comes out unchanged at every cutoff from 20 Hz to Nyquist, and
+// a silent input after it settles back to silence. Full scale squares and
+// noise stay close to a double precision run of the same design, so no sum
+// wraps. A cutoff jump follows the reference gliding over one block and
+// stays inside the passband ripple. Also prints the cost per sample.
+#include "Filter.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+static const float FS = 44100.f;
+static const size_t BLOCK = 256;
+
+static uint32_t random_state = 1;
+static uint32_t next_random() {
+    random_state = random_state * 1664525u + 1013904223u;
+    return random_state >> 8;
+}
+
+static long failures = 0;
+
+#define CHECK(cond, ...)                                                       \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            if (failures < 20) {                                               \
+                printf("  ");                                                  \
+                printf(__VA_ARGS__);                                           \
+                printf("\n");                                                  \
+            }                                                                  \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+// Runs the whole of x through the filter in blocks
+static void run(FilterCheb &filter, std::vector<int16_t> &x) {
+    for (size_t start = 0; start < x.size(); start += BLOCK) {
+        size_t size = std::min(BLOCK, x.size() - start);
+        filter.out(x.data() + start, size);
+    }
+}
+
+// The same cascade in double precision, no quantization anywhere
+struct Reference {
+    struct Section {
+        double g, e1, x1, x2, y1, y2;
+    } sections[m];
+
+    Reference(double fc, double epsilon) {
+        fc = fc < 20. ? 20. : (fc > 0.45 * FS ? 0.45 * FS : fc);
+        double a = tan(M_PI * fc / FS);
+        double u = log((1. + sqrt(1. + epsilon * epsilon)) / epsilon);
+        double su = sinh(u / N_Cheb);
+        double cu = cosh(u / N_Cheb);
+        for (int i = 0; i < m; ++i) {
+            int pole = m - 1 - i;
+            double angle = M_PI * (2 * pole + 1) / (2 * N_Cheb);
+            double b = sin(angle) * su;
+            double c = cos(angle) * cu;
+            c = b * b + c * c;
+            double s = a * a * c + 2. * a * b + 1.;
+            sections[i] = {4. * a * a * c / s, 4. * a * (a * c + b) / s, 0, 0,
+                           0, 0};
+        }
+    }
+
+    // A fraction t of the way from the coefficients of a to those of b,
+    // the states stay
+    void glide(const Reference &a, const Reference &b, double t) {
+        for (int i = 0; i < m; ++i) {
+            const Section &from = a.sections[i], &to = b.sections[i];
+            sections[i].g = from.g + t * (to.g - from.g);
+            sections[i].e1 = from.e1 + t * (to.e1 - from.e1);
+        }
+    }
+
+    double process(double x) {
+        for (Section &s : sections) {
+            double y = 2. * s.y1 - s.y2 +
+                       s.g * (x + 2. * s.x1 + s.x2 - 4. * s.y2) / 4. -
+                       s.e1 * (s.y1 - s.y2);
+            s.x2 = s.x1;
+            s.x1 = x;
+            s.y2 = s.y1;
+            s.y1 = y;
+            x = y;
+        }
+        return x;
+    }
+};
+
+static std::vector<float> cutoffs() {
+    std::vector<float> fcs;
+    for (float fc = 20.f; fc < FS / 2; fc *= 1.25f)
+        fcs.push_back(fc);
+    fcs.push_back(FS / 2);
+    return fcs;
+}
+
+static void check_dc(float fc, float epsilon) {
+    FilterCheb filter(fc, epsilon);
+    // Long enough for the slowest section to settle, its time constant
+    // grows as the cutoff falls
+    const size_t settle = (size_t)(FS * std::max(3.f, 150.f / fc));
+    for (int16_t level : {10000, -10000, 37, -1, 32767}) {
+        std::vector<int16_t> x(settle, level);
+        run(filter, x);
+        int worst = 0;
+        for (size_t n = settle - BLOCK; n < settle; n++) {
+            if (std::abs(x[n] - level) > std::abs(worst))
+                worst = x[n] - level;
+        }
+        CHECK(worst == 0, "fc %.0f eps %.1f: DC %d comes out %d off", fc,
+              epsilon, level, worst);
+    }
+
+    std::vector<int16_t> silence(settle, 0);
+    run(filter, silence);
+    int worst = 0;
+    for (size_t n = settle - BLOCK; n < settle; n++)
+        worst = std::max(worst, std::abs((int)silence[n]));
+    CHECK(worst == 0, "fc %.0f eps %.1f: silence settles at %d", fc, epsilon,
+          worst);
+}
+
+// Largest difference to the reference over a full scale square at a
+// frequency around the cutoff and over full scale noise
+static int check_against_reference(float fc, float epsilon) {
+    int worst = 0;
+    for (int signal = 0; signal < 4; signal++) {
+        FilterCheb filter(fc, epsilon);
+        Reference reference(fc, epsilon);
+        const float ratios[] = {0.5f, 0.9f, 1.f};
+        std::vector<int16_t> x(FS);
+        for (size_t n = 0; n < x.size(); n++) {
+            if (signal < 3) {
+                float f = std::min(fc, 0.45f * FS) * ratios[signal];
+                x[n] = fmodf(n * f / FS, 1.f) < 0.5f ? 32767 : -32767;
+            } else {
+                x[n] = next_random() & 1 ? 32767 : -32767;
+            }
+        }
+        std::vector<int16_t> y = x;
+        run(filter, y);
+        for (size_t n = 0; n < x.size(); n++) {
+            double r = reference.process(x[n]);
+            r = r > 32767. ? 32767. : (r < -32768. ? -32768. : r);
+            worst = std::max(worst, (int)fabs(y[n] - r));
+        }
+    }
+    return worst;
+}
+
+// Peak over [from, to)
+static int peak(const std::vector<int16_t> &x, size_t from, size_t to) {
+    int p = 0;
+    for (size_t n = from; n < to; n++)
+        p = std::max(p, std::abs((int)x[n]));
+    return p;
+}
+
+// A jump of the cutoff glides over one block the way the reference does
+// with g and e1 moving in a straight line, and so stays inside the ripple
+// of the passband
+static void check_glide(float amplitude) {
+    const float epsilon = 1.f;
+    FilterCheb filter(1000.f, epsilon);
+    Reference reference(1000.f, epsilon);
+    const Reference from = reference, to(5000.f, epsilon);
+    const size_t jump = 64 * BLOCK;
+    std::vector<int16_t> x(2 * jump);
+    for (size_t n = 0; n < x.size(); n++)
+        x[n] = (int16_t)(amplitude * sinf(2.f * (float)M_PI * 300.f * n / FS));
+
+    std::vector<int16_t> y = x;
+    int worst = 0;
+    for (size_t start = 0; start < x.size(); start += BLOCK) {
+        if (start == jump)
+            filter.set_cutoff_freq(5000.f, epsilon);
+        filter.out(y.data() + start, BLOCK);
+        for (size_t n = start; n < start + BLOCK; n++) {
+            if (n >= jump && n < jump + BLOCK)
+                reference.glide(from, to, (double)(n - jump + 1) / BLOCK);
+            double r = reference.process(x[n]);
+            worst = std::max(worst, (int)fabs(y[n] - r));
+        }
+    }
+    int before = peak(y, jump - 8 * BLOCK, jump);
+    int during = peak(y, jump, jump + BLOCK);
+    int after = peak(y, jump + 8 * BLOCK, y.size());
+    printf("glide at %5.0f: peak %d before, %d in the glide, %d after, %d "
+           "off the reference\n",
+           amplitude, before, during, after, worst);
+    CHECK(worst < 16, "glide at %.0f is %d off the reference", amplitude,
+          worst);
+    // The passband ripples up to sqrt(1 + epsilon^2), the moving cutoff
+    // adds a little
+    float bound = 1.05f * sqrtf(1.f + epsilon * epsilon) * amplitude;
+    CHECK(during < bound && during < INT16_MAX,
+          "glide at %.0f peaks at %d, over %.0f", amplitude, during, bound);
+}
+
+static void time_filter() {
+    FilterCheb filter(2000.f, 1.f);
+    std::vector<int16_t> x(BLOCK);
+    double best = 1e9;
+    for (int run = 0; run < 5; run++) {
+        const int blocks = 4000;
+        auto start = std::chrono::steady_clock::now();
+        for (int b = 0; b < blocks; b++) {
+            for (size_t n = 0; n < BLOCK; n++)
+                x[n] = (int16_t)(next_random() & 0x3FFF) - 0x2000;
+            filter.out(x.data(), BLOCK);
+        }
+        auto stop = std::chrono::steady_clock::now();
+        double ns =
+            std::chrono::duration<double, std::nano>(stop - start).count();
+        best = std::min(best, ns / (blocks * BLOCK));
+    }
+    printf("%.1f ns/sample on this host\n", best);
+}
+
+int main() {
+    for (float epsilon : {0.5f, 1.f, 2.f}) {
+        int worst = 0;
+        float worst_fc = 0;
+        for (float fc : cutoffs()) {
+            check_dc(fc, epsilon);
+            int error = check_against_reference(fc, epsilon);
+            if (error > worst) {
+                worst = error;
+                worst_fc = fc;
+            }
+        }
+        printf("eps %.1f: DC sweep done, worst error to the reference %d "
+               "at %.0f Hz\n",
+               epsilon, worst, worst_fc);
+        // Coefficient rounding moves the response a little, a wrapped sum
+        // would be off by full scale
+        CHECK(worst < 32, "eps %.1f: %d off the reference", epsilon, worst);
+    }
+
+    check_glide(4000.f);
+    check_glide(16000.f);
+    time_filter();
+
+    printf("%s (%ld failed checks)\n", failures == 0 ? "ok" : "FAIL",
+           failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,315 @@
+// Stress test of VoiceAllocator against a plain reference model.
+//
+// Millions of random note-ons, note-offs, finished tails, voice limit
+// changes and policy switches go through the allocator. After every event
+// the note map, the voice states, the released list and the counts must
+// match the model, and every steal must take the voice its policy names.
+// A timing pass then checks that an event costs the same with every voice
+// sounding as with two, for the policies that do not scan. With --timing
+// it only prints the worst of those costs, check_scaling.cmake compares it
+// between builds with different NUM_OSC.
+#include "VoiceAllocator.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static uint32_t random_state = 1;
+static uint32_t next_random() {
+    random_state = random_state * 1664525u + 1013904223u;
+    return random_state >> 8;
+}
+
+static long failures = 0;
+
+#define CHECK(cond)                                                            \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            if (failures < 10)                                                 \
+                printf("  %s:%d: %s\n", __FILE__, __LINE__, #cond);            \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+// What the allocator should be doing, with none of its cleverness
+struct Model {
+    enum State { FREE, HELD, RELEASED };
+
+    State state[NUM_OSC];
+    int note[NUM_OSC];
+    uint64_t on_time[NUM_OSC];      // last note-on, for the age order
+    std::vector<int> released;      // in order of release
+    int note_to_voice[128];
+    int limit = NUM_OSC;
+    VoiceAllocator::StealPolicy policy = VoiceAllocator::STEAL_RELEASED_FIRST;
+    uint64_t clock = 0;
+
+    Model() {
+        std::fill(state, state + NUM_OSC, FREE);
+        std::fill(note, note + NUM_OSC, -1);
+        std::fill(on_time, on_time + NUM_OSC, 0);
+        std::fill(note_to_voice, note_to_voice + 128, -1);
+    }
+
+    int active() const {
+        int count = 0;
+        for (int v = 0; v < NUM_OSC; v++)
+            count += state[v] != FREE;
+        return count;
+    }
+
+    int oldest(State wanted) const {
+        int best = -1;
+        for (int v = 0; v < NUM_OSC; v++) {
+            if (state[v] == wanted &&
+                (best < 0 || on_time[v] < on_time[best]))
+                best = v;
+        }
+        return best;
+    }
+
+    int oldest_sounding() const {
+        int best = -1;
+        for (int v = 0; v < NUM_OSC; v++) {
+            if (state[v] != FREE && (best < 0 || on_time[v] < on_time[best]))
+                best = v;
+        }
+        return best;
+    }
+
+    int victim(const q8_24_t *levels) const {
+        switch (policy) {
+        case VoiceAllocator::STEAL_OLDEST:
+            return oldest_sounding();
+        case VoiceAllocator::STEAL_QUIETEST:
+            if (levels != nullptr) {
+                // Ties go to the older voice
+                int best = -1;
+                for (int v = 0; v < NUM_OSC; v++) {
+                    if (state[v] == FREE)
+                        continue;
+                    if (best < 0 || levels[v] < levels[best] ||
+                        (levels[v] == levels[best] &&
+                         on_time[v] < on_time[best]))
+                        best = v;
+                }
+                return best;
+            }
+            [[fallthrough]];
+        default:
+            return !released.empty() ? released.front() : oldest(HELD);
+        }
+    }
+
+    void free_voice(int v) {
+        if (note[v] >= 0 && note_to_voice[note[v]] == v)
+            note_to_voice[note[v]] = -1;
+        note[v] = -1;
+        if (state[v] == RELEASED)
+            released.erase(std::find(released.begin(), released.end(), v));
+        state[v] = FREE;
+    }
+
+    void start(int v, int new_note) {
+        if (state[v] == RELEASED)
+            released.erase(std::find(released.begin(), released.end(), v));
+        state[v] = HELD;
+        note[v] = new_note;
+        note_to_voice[new_note] = v;
+        on_time[v] = ++clock;
+    }
+};
+
+static void check_state(const VoiceAllocator &alloc, const Model &model) {
+    CHECK(alloc.active_count() == model.active());
+    CHECK(alloc.get_voice_limit() == model.limit);
+    for (int v = 0; v < NUM_OSC; v++) {
+        CHECK(alloc.note_for_voice(v) == model.note[v]);
+        CHECK(alloc.is_held(v) == (model.state[v] == Model::HELD));
+        CHECK(alloc.is_released(v) == (model.state[v] == Model::RELEASED));
+    }
+    for (int n = 0; n < 128; n++) {
+        int v = alloc.voice_for_note(n);
+        CHECK(v == model.note_to_voice[n]);
+        if (v >= 0)
+            CHECK(alloc.note_for_voice(v) == n);
+    }
+
+    // The released list is in release order and ends, no cycles
+    size_t steps = 0;
+    for (int v = alloc.first_released(); v >= 0 && steps <= NUM_OSC;
+         v = alloc.next_released(v), steps++) {
+        CHECK(steps < model.released.size() && model.released[steps] == v);
+    }
+    CHECK(steps == model.released.size());
+}
+
+static void fill_levels(q8_24_t *levels) {
+    // Few distinct levels, so ties are common
+    for (int v = 0; v < NUM_OSC; v++)
+        levels[v] = (q8_24_t)(next_random() % 16) << 20;
+}
+
+static void stress(VoiceAllocator::StealPolicy policy, long events) {
+    VoiceAllocator alloc;
+    Model model;
+    alloc.set_policy(policy);
+    model.policy = policy;
+
+    q8_24_t levels[NUM_OSC];
+    long steals = 0;
+    for (long i = 0; i < events; i++) {
+        uint32_t what = next_random() % 100;
+        // A narrow note range so retriggers and tails are common
+        uint8_t note = 40 + next_random() % (NUM_OSC + 8);
+
+        if (what < 45) {
+            fill_levels(levels);
+            const bool pass_levels = next_random() % 4 != 0;
+            const q8_24_t *levels_ptr = pass_levels ? levels : nullptr;
+
+            int expected = model.note_to_voice[note];
+            int expected_stolen = -1;
+            if (expected < 0) {
+                bool free_left = model.active() < NUM_OSC;
+                if (free_left && model.active() < model.limit) {
+                    // The head of the free list, any free voice will do
+                    expected = -2;
+                } else {
+                    expected = model.victim(levels_ptr);
+                    expected_stolen = model.note[expected];
+                }
+            }
+
+            VoiceAllocator::Allocation a = alloc.note_on(note, levels_ptr);
+            CHECK(a.voice >= 0);
+            if (a.voice < 0)
+                continue;
+            if (expected == -2) {
+                CHECK(model.state[a.voice] == Model::FREE);
+                CHECK(a.stolen_note == -1);
+            } else {
+                CHECK(a.voice == expected);
+                CHECK(a.stolen_note == expected_stolen);
+                CHECK(a.retrigger == (model.note[a.voice] == note));
+                if (expected_stolen >= 0) {
+                    steals++;
+                    model.free_voice(a.voice);
+                }
+            }
+            model.start(a.voice, note);
+            CHECK(alloc.active_count() <= alloc.get_voice_limit());
+        } else if (what < 85) {
+            int expected = model.note_to_voice[note];
+            if (expected >= 0 && model.state[expected] != Model::HELD)
+                expected = -1;
+            CHECK(alloc.note_off(note) == expected);
+            if (expected >= 0) {
+                model.state[expected] = Model::RELEASED;
+                model.released.push_back(expected);
+            }
+        } else if (what < 97) {
+            // A tail ends, or a voice that is not in one is reported
+            int v = next_random() % NUM_OSC;
+            alloc.voice_finished(v);
+            if (model.state[v] == Model::RELEASED)
+                model.free_voice(v);
+        } else if (what < 99) {
+            // The governor moves the limit and steals down to it
+            int limit = 1 + next_random() % NUM_OSC;
+            alloc.set_voice_limit(limit);
+            model.limit = limit;
+            while (alloc.active_count() > alloc.get_voice_limit()) {
+                fill_levels(levels);
+                int expected = model.victim(levels);
+                int stolen_note = -2;
+                int v = alloc.steal(levels, &stolen_note);
+                CHECK(v == expected);
+                if (v < 0)
+                    break;
+                CHECK(stolen_note == model.note[v]);
+                model.free_voice(v);
+            }
+        } else {
+            // Switching policy leaves the lists alone
+            auto next = static_cast<VoiceAllocator::StealPolicy>(
+                next_random() % VoiceAllocator::NUM_STEAL_POLICIES);
+            alloc.set_policy(next);
+            model.policy = next;
+        }
+        check_state(alloc, model);
+    }
+    printf("%-16s %ld events, %ld steals\n", steal_policy_to_string(policy),
+           events, steals);
+}
+
+// Nanoseconds per event of a note stream that keeps about `sounding`
+// voices busy, best of a few runs
+static double time_events(VoiceAllocator::StealPolicy policy, int sounding) {
+    const long events = 1000000;
+    double best = 1e9;
+    for (int run = 0; run < 5; run++) {
+        VoiceAllocator alloc;
+        alloc.set_policy(policy);
+        alloc.set_voice_limit(sounding);
+        random_state = 7;
+
+        auto start = std::chrono::steady_clock::now();
+        for (long i = 0; i < events; i++) {
+            uint32_t r = next_random();
+            uint8_t note = r & 0x7F;
+            switch ((r >> 7) % 4) {
+            case 0:
+            case 1:
+                alloc.note_on(note);
+                break;
+            case 2:
+                alloc.note_off(note);
+                break;
+            default:
+                alloc.voice_finished(alloc.first_released());
+                break;
+            }
+        }
+        auto stop = std::chrono::steady_clock::now();
+        double ns =
+            std::chrono::duration<double, std::nano>(stop - start).count();
+        best = std::min(best, ns / events);
+    }
+    return best;
+}
+
+int main(int argc, char **argv) {
+    // Quietest scans the sounding voices when it steals, by design
+    const VoiceAllocator::StealPolicy flat[] = {
+        VoiceAllocator::STEAL_RELEASED_FIRST, VoiceAllocator::STEAL_OLDEST};
+
+    if (argc > 1 && strcmp(argv[1], "--timing") == 0) {
+        double worst = 0;
+        for (VoiceAllocator::StealPolicy policy : flat)
+            worst = std::max(worst, time_events(policy, NUM_OSC));
+        // Tenths of a nanosecond, CMake only compares integers
+        printf("%ld\n", (long)(worst * 10));
+        return 0;
+    }
+
+    printf("NUM_OSC = %d\n", NUM_OSC);
+    for (int p = 0; p < VoiceAllocator::NUM_STEAL_POLICIES; p++) {
+        random_state = 1 + p;
+        stress(static_cast<VoiceAllocator::StealPolicy>(p), 2000000);
+    }
+
+    for (VoiceAllocator::StealPolicy policy : flat) {
+        double few = time_events(policy, 2);
+        double all = time_events(policy, NUM_OSC);
+        printf("%-16s %.1f ns/event with 2 voices, %.1f with %d\n",
+               steal_policy_to_string(policy), few, all, NUM_OSC);
+        // A scan over the voices would be NUM_OSC / 2 times slower
+        CHECK(all < 3.0 * few);
+    }
+
+    printf("%s (%ld failed checks)\n", failures == 0 ? "ok" : "FAIL",
+           failures);
+    return failures == 0 ? 0 : 1;
+}